@@ -5,4 +5,7 @@ rem    ffmpeg -hide_banner -framerate 60 -i raw\div_bg_%%r_%%04d.png ^
 rem        -c:v libvpx-vp9 -pix_fmt yuva420p -y %%r.webm
     ffmpeg -hide_banner -framerate 60 -i raw\div_bg_%%r-%%04d.png ^
         -c:v libvpx-vp9 -pix_fmt yuv420p -y div_bg_%%r.webm
-)
\ No newline at end of file
+)
+rem packed output from --packed, all combos in one stream
+rem ffmpeg -hide_banner -framerate 60 -i raw\div_bg_packed-%%04d.png ^
+rem     -c:v libvpx-vp9 -pix_fmt yuv420p -y div_bg_packed.webm
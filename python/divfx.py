@@ -0,0 +1,106 @@
+"""Renders divination card backgrounds in-process through the divfx_api library.
+
+Frames go straight into memory the caller owns: anything exporting a writable buffer, such as a bytearray, a
+memoryview, an mmap or a C-contiguous numpy array of shape (height, width, 4) and dtype uint8, is filled in place.
+
+    with Renderer(asset_root, prelude_root) as fx:
+        fx.select_combo(0)
+        frames = numpy.empty((60, fx.height, fx.width, 4), numpy.uint8)
+        fx.render_frames(0, frames)
+"""
+
+import ctypes
+import os
+
+
+class DivFxError(RuntimeError):
+    pass
+
+
+class _FrameInfo(ctypes.Structure):
+    _fields_ = [
+        ("width", ctypes.c_uint32),
+        ("height", ctypes.c_uint32),
+        ("min_row_pitch", ctypes.c_uint32),
+        ("frame_count", ctypes.c_int32),
+        ("fps", ctypes.c_float),
+    ]
+
+
+def _load(path):
+    lib = ctypes.CDLL(path)
+    ctx = ctypes.c_void_p
+    lib.divfx_open.argtypes = [ctypes.c_char_p, ctypes.c_char_p, ctypes.c_char_p, ctypes.POINTER(ctx)]
+    lib.divfx_close.argtypes = [ctx]
+    lib.divfx_close.restype = None
+    lib.divfx_last_error.restype = ctypes.c_char_p
+    lib.divfx_combo_count.argtypes = [ctx]
+    lib.divfx_combo_name.argtypes = [ctx, ctypes.c_int32]
+    lib.divfx_combo_name.restype = ctypes.c_char_p
+    lib.divfx_select_combo.argtypes = [ctx, ctypes.c_int32]
+    lib.divfx_get_frame_info.argtypes = [ctx, ctypes.POINTER(_FrameInfo)]
+    lib.divfx_render_frames.argtypes = [ctx, ctypes.c_int32, ctypes.c_int32, ctypes.c_void_p, ctypes.c_size_t,
+                                        ctypes.c_size_t, ctypes.c_size_t]
+    return lib
+
+
+def _writable(buffer):
+    """Address and size of a writable buffer, without copying it."""
+    view = memoryview(buffer)
+    if view.readonly or not view.c_contiguous:
+        raise DivFxError("frames need a writable, C-contiguous buffer")
+    size = view.nbytes
+    return ctypes.addressof((ctypes.c_char * size).from_buffer(view.cast("B"))), size
+
+
+class Renderer:
+    def __init__(self, asset_root, prelude_root, layers_path=None, library=None):
+        self._lib = _load(library or os.environ.get("DIVFX_API", "divfx_api.dll"))
+        self._ctx = ctypes.c_void_p()
+        self._check(self._lib.divfx_open(os.fsencode(asset_root), os.fsencode(prelude_root),
+                                         os.fsencode(layers_path) if layers_path else None, ctypes.byref(self._ctx)))
+        info = _FrameInfo()
+        self._check(self._lib.divfx_get_frame_info(self._ctx, ctypes.byref(info)))
+        self.width, self.height, self.frame_count, self.fps = info.width, info.height, info.frame_count, info.fps
+        self.frame_size = info.min_row_pitch * info.height
+
+    def close(self):
+        if self._ctx:
+            self._lib.divfx_close(self._ctx)
+            self._ctx = ctypes.c_void_p()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def _check(self, status):
+        if status != 0:
+            raise DivFxError(self._lib.divfx_last_error().decode("utf-8", "replace"))
+
+    @property
+    def combos(self):
+        count = self._lib.divfx_combo_count(self._ctx)
+        return [self._lib.divfx_combo_name(self._ctx, i).decode() for i in range(count)]
+
+    def select_combo(self, combo):
+        """Selects a combo by index or by its export name, such as "div_bg_0_1"."""
+        if isinstance(combo, str):
+            combo = self.combos.index(combo)
+        self._check(self._lib.divfx_select_combo(self._ctx, combo))
+
+    def render_frames(self, first, out, count=None, row_pitch=None, frame_pitch=None):
+        """Renders count frames starting at first into out, tightly packed unless pitches are given."""
+        address, size = _writable(out)
+        row_pitch = row_pitch or 4 * self.width
+        frame_pitch = frame_pitch or row_pitch * self.height
+        if count is None:
+            count = size // frame_pitch
+        self._check(self._lib.divfx_render_frames(self._ctx, first, count, address, row_pitch, frame_pitch, size))
+        return out
+
+    def render_frame(self, frame, out=None):
+        """Renders one frame into out, or into a new bytearray."""
+        out = bytearray(self.frame_size) if out is None else out
+        return self.render_frames(frame, out, count=1)
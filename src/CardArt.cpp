@@ -0,0 +1,178 @@
+#include "CardArt.hpp"
+#include "Util.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <sstream>
+#include <type_traits>
+
+std::string DivinationCardArt::Name() const {
+    auto slash = virtualFile.find_last_of("/\\");
+    return slash == std::string::npos ? virtualFile : virtualFile.substr(slash + 1);
+}
+
+std::string DivinationCardArt::Title() const {
+    auto name = Name();
+    std::string ret;
+    for (size_t i = 0; i < name.size(); ++i) {
+        if (i > 0 && isupper((unsigned char)name[i]) && !isupper((unsigned char)name[i - 1])) {
+            ret += ' ';
+        }
+        ret += name[i];
+    }
+    return ret;
+}
+
+namespace {
+template <typename T> bool ReadAt(std::string const &data, size_t offset, T &out) {
+    if (offset > data.size() || data.size() - offset < sizeof(T)) {
+        return false;
+    }
+    memcpy(&out, data.data() + offset, sizeof(T));
+    return true;
+}
+
+// Strings are UTF-16LE in the data section; the art paths are plain ASCII.
+std::optional<std::string> ReadString(std::string const &data, size_t offset) {
+    std::string ret;
+    for (uint16_t ch; ReadAt(data, offset, ch); offset += 2) {
+        if (ch == 0) {
+            return ret;
+        }
+        ret += ch < 0x80 ? (char)ch : '?';
+    }
+    return std::nullopt;
+}
+} // namespace
+
+std::optional<std::vector<DivinationCardArt>> LoadDivinationCardArt(std::filesystem::path const &path) {
+    if (!exists(path)) {
+        fmt::print("Card table {} not found.\n", path.string());
+        return std::nullopt;
+    }
+    auto data = SlurpTextFile(path);
+    auto fail = [&](std::string_view what) {
+        fmt::print("{}: {}\n", path.string(), what);
+        return std::nullopt;
+    };
+
+    // Layout: row count, fixed-size rows, then the variable data section starting with eight 0xBB bytes, which
+    // string and list offsets are relative to.
+    uint32_t rowCount{};
+    auto magic = data.find(std::string(8, '\xBB'));
+    if (!ReadAt(data, 0, rowCount) || magic == std::string::npos) {
+        return fail("not a dat64 table");
+    }
+    size_t rowSize = rowCount ? (magic - 4) / rowCount : 0;
+    // key (row, unused), string offset, list count and offset
+    enum { eKeyOffset = 0, eStringOffset = 16, eListOffset = 24, eMinRowSize = 40 };
+    if (rowCount && (rowSize < eMinRowSize || (magic - 4) % rowCount)) {
+        return fail("unexpected row layout");
+    }
+
+    std::vector<DivinationCardArt> ret;
+    for (uint32_t row = 0; row < rowCount; ++row) {
+        size_t base = 4 + row * rowSize;
+        DivinationCardArt entry;
+        uint64_t stringOffset{}, listCount{}, listOffset{};
+        ReadAt(data, base + eKeyOffset, entry.baseItemRow);
+        ReadAt(data, base + eStringOffset, stringOffset);
+        ReadAt(data, base + eListOffset, listCount);
+        ReadAt(data, base + eListOffset + 8, listOffset);
+        auto file = ReadString(data, magic + stringOffset);
+        if (!file) {
+            return fail(fmt::format("row {} has a bad art path", row));
+        }
+        entry.virtualFile = *file;
+        for (uint64_t i = 0; i < listCount; ++i) {
+            int32_t influence{};
+            if (!ReadAt(data, magic + listOffset + 4 * i, influence)) {
+                return fail(fmt::format("row {} has a bad influence list", row));
+            }
+            entry.influences.push_back(influence);
+        }
+        ret.push_back(std::move(entry));
+    }
+    return ret;
+}
+
+std::optional<CardLayout> LoadCardLayout(std::filesystem::path const &path) {
+    if (!exists(path)) {
+        fmt::print("Card layout {} not found.\n", path.string());
+        return std::nullopt;
+    }
+    CardLayout ret;
+    std::istringstream is(SlurpTextFile(path));
+    std::string line;
+    int lineNo = 0;
+    auto fail = [&](std::string_view what) {
+        fmt::print("{}:{}: {}\n", path.string(), lineNo, what);
+        return std::nullopt;
+    };
+    auto parse = [](std::string const &text, auto &out, int base = 10) {
+        std::from_chars_result res;
+        if constexpr (std::is_floating_point_v<std::remove_reference_t<decltype(out)>>) {
+            res = std::from_chars(text.data(), text.data() + text.size(), out);
+        } else {
+            res = std::from_chars(text.data(), text.data() + text.size(), out, base);
+        }
+        return res.ec == std::errc{} && res.ptr == text.data() + text.size();
+    };
+    auto parseRect = [&](std::vector<std::string> const &tokens, size_t first, PixelRect &rect) {
+        return parse(tokens[first], rect.x) && parse(tokens[first + 1], rect.y) &&
+               parse(tokens[first + 2], rect.width) && parse(tokens[first + 3], rect.height) && !rect.Empty();
+    };
+    while (std::getline(is, line)) {
+        ++lineNo;
+        if (auto hash = line.find('#'); hash != std::string::npos) {
+            line.resize(hash);
+        }
+        std::vector<std::string> tokens;
+        std::istringstream ls(line);
+        for (std::string token; ls >> token;) {
+            tokens.push_back(token);
+        }
+        if (tokens.empty()) {
+            continue;
+        }
+
+        if (tokens[0] == "size" && tokens.size() == 3) {
+            if (!parse(tokens[1], ret.width) || !parse(tokens[2], ret.height)) {
+                return fail("malformed size");
+            }
+        } else if (tokens[0] == "background" && tokens.size() == 5) {
+            if (!parseRect(tokens, 1, ret.background)) {
+                return fail("malformed background rectangle");
+            }
+        } else if (tokens[0] == "image" && tokens.size() == 6) {
+            CardStaticLayer layer{.kind = CardLayerKind::Image, .path = tokens[1]};
+            if (!parseRect(tokens, 2, layer.rect)) {
+                return fail("malformed image rectangle");
+            }
+            ret.layers.push_back(layer);
+        } else if (tokens[0] == "title" && tokens.size() == 8) {
+            CardStaticLayer layer{.kind = CardLayerKind::Title, .font = tokens[5]};
+            std::replace(layer.font.begin(), layer.font.end(), '_', ' ');
+            if (!parseRect(tokens, 1, layer.rect) || !parse(tokens[6], layer.fontSize) ||
+                !parse(tokens[7], layer.color, 16)) {
+                return fail("malformed title");
+            }
+            ret.layers.push_back(layer);
+        } else {
+            return fail(fmt::format("unexpected '{}'", tokens[0]));
+        }
+    }
+    if (ret.width <= 0 || ret.height <= 0 || ret.background.Empty()) {
+        lineNo = 0;
+        return fail("the layout needs a size and a background rectangle");
+    }
+    auto &bg = ret.background;
+    if (bg.x < 0 || bg.y < 0 || bg.x + bg.width > ret.width || bg.y + bg.height > ret.height) {
+        lineNo = 0;
+        return fail("the background rectangle must lie within the card");
+    }
+    return ret;
+}
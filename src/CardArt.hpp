@@ -0,0 +1,48 @@
+#pragma once
+
+#include "FramePool.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+// One row of DivinationCardArt.dat64: the card's art and the influence layers animating behind it.
+struct DivinationCardArt {
+    uint64_t baseItemRow{};
+    std::string virtualFile; // for example Art/2DItems/Divination/Images/TheDoctor
+    std::vector<int> influences;
+
+    // Last path component of the art, used to name the card's output.
+    std::string Name() const;
+    // The name split at its capitals, "TheDoctor" becomes "The Doctor".
+    std::string Title() const;
+};
+
+// Reads the BaseItemTypesKey, VirtualFile and influence list columns at the start of each row, ignoring any columns
+// after them.
+std::optional<std::vector<DivinationCardArt>> LoadDivinationCardArt(std::filesystem::path const &path);
+
+enum class CardLayerKind {
+    Image, // texture scaled into the rectangle
+    Title, // the card's title text
+};
+
+struct CardStaticLayer {
+    CardLayerKind kind{};
+    PixelRect rect{};
+    std::string path{}; // Image: texture path, {art} expands to the card's VirtualFile
+    std::string font{}; // Title: font family
+    float fontSize{};
+    uint32_t color{}; // Title: BGRA
+};
+
+// Placement of the animated background and the static layers drawn over it, bottom to top.
+struct CardLayout {
+    int width{}, height{};
+    PixelRect background;
+    std::vector<CardStaticLayer> layers;
+};
+
+std::optional<CardLayout> LoadCardLayout(std::filesystem::path const &path);
@@ -0,0 +1,220 @@
+#include "CardLayers.hpp"
+#include "TaskGraph.hpp"
+#include "Util.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <chrono>
+
+CardLayers::CardLayers(Dx &dx, std::filesystem::path preludePath, std::filesystem::path assetRoot,
+                       LayerCatalog const &catalog, ShaderProfile profile)
+    : dx_(dx), combos_(catalog.combos), preludePath_(preludePath), assetRoot_(assetRoot), profile_(profile) {
+    compiler_ = std::make_unique<DivFxCompiler>(assetRoot_, SlurpTextFile(preludePath_), profile_);
+
+    // Shader compiles and texture reads are independent of each other, so they run across all cores; each layer
+    // is built as soon as the vertex shader, its pixel shader and its textures are ready.
+    size_t layerCount = catalog.layers.size();
+    sources_.resize(layerCount);
+    atlasCards_.resize(layerCount);
+    std::vector<CardLayerVariant> variants(layerCount);
+
+    // Each texture is preloaded once for the footprints of all layers binding it, so no layer finds it trimmed too far.
+    std::map<std::pair<std::filesystem::path, bool>, TextureFootprint> footprints;
+    for (auto &desc : catalog.layers) {
+        for (auto &texDesc : desc.textures) {
+            if (texDesc.solid || texDesc.path.empty()) {
+                continue;
+            }
+            auto key = std::make_pair(std::filesystem::path(texDesc.path), texDesc.srgb);
+            auto [I, inserted] = footprints.try_emplace(key, LayerFootprint(desc));
+            if (!inserted) {
+                I->second = I->second.Union(LayerFootprint(desc));
+            }
+        }
+    }
+
+    TaskGraph startup;
+    auto vsTask = startup.Add("compile vertex shader", [this] { compiler_->CompileVertexShader(); });
+    std::map<std::pair<std::filesystem::path, bool>, TaskGraph::TaskId> textureTasks;
+    for (size_t i = 0; i < layerCount; ++i) {
+        auto &desc = catalog.layers[i];
+        sources_[i].desc = &desc;
+        names_.push_back(desc.name);
+        auto &fragment = Fragment(assetRoot_ / desc.fragment);
+
+        std::vector<TaskGraph::TaskId> layerDeps{vsTask};
+        auto compile = [&, i, &text = fragment] { variants[i] = CompileVariant(sources_[i], text); };
+        layerDeps.push_back(startup.Add(fmt::format("compile {} ({})", desc.name, desc.entrypoint), compile));
+        for (auto &texDesc : desc.textures) {
+            if (texDesc.solid || texDesc.path.empty()) {
+                continue;
+            }
+            auto key = std::make_pair(texDesc.path, texDesc.srgb);
+            if (!textureTasks.contains(key)) {
+                auto label = fmt::format("load {}", std::filesystem::path(texDesc.path).filename().string());
+                textureTasks[key] = startup.Add(label, [&dx, key, footprint = footprints[key]] {
+                    dx.LoadTexture(key.first, key.second, footprint);
+                });
+            }
+            layerDeps.push_back(textureTasks[key]);
+        }
+        startup.Add(fmt::format("build {}", desc.name), [&, i] { atlasCards_[i] = MakeLayer(variants[i]); }, layerDeps);
+    }
+    startup.Run();
+    startup.PrintTimings("Startup");
+    if (int fallbacks = specializationFallbacks_) {
+        fmt::print("{} of {} layers failed their specialized compile and run unspecialized shaders.\n", fallbacks,
+                   layerCount);
+    }
+}
+
+std::set<std::filesystem::path> CardLayers::WatchedDirectories() const {
+    std::set<std::filesystem::path> dirs{preludePath_.parent_path()};
+    for (auto &path : compiler_->VSDependencies()) {
+        dirs.insert(path.parent_path());
+    }
+    for (auto &source : sources_) {
+        for (auto &path : source.dependencies) {
+            dirs.insert(path.parent_path());
+        }
+    }
+    return dirs;
+}
+
+std::vector<std::filesystem::path> CardLayers::ShaderSources() const {
+    std::set<std::filesystem::path> files{preludePath_.lexically_normal()};
+    files.insert(compiler_->VSDependencies().begin(), compiler_->VSDependencies().end());
+    for (auto &source : sources_) {
+        files.insert(source.dependencies.begin(), source.dependencies.end());
+    }
+    return {files.begin(), files.end()};
+}
+
+void CardLayers::Reload(std::vector<std::filesystem::path> const &changed) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::string> changedKeys;
+    for (auto &path : changed) {
+        changedKeys.push_back(PathKey(path));
+        compiler_->InvalidateInclude(path);
+        fragments_.erase(changedKeys.back());
+    }
+    // A directory stands for every file in it when its change list overflowed.
+    auto affected = [&](std::filesystem::path const &path) {
+        auto key = PathKey(path);
+        return std::any_of(changedKeys.begin(), changedKeys.end(), [&](auto &changedKey) {
+            return key == changedKey || key.starts_with(changedKey + "/");
+        });
+    };
+
+    // The prelude is compiled into every shader. The vertex shader's own files only concern the layers that include
+    // them too, which their dependencies already say.
+    auto &vsDependencies = compiler_->VSDependencies();
+    bool rebuildAll = affected(preludePath_);
+    bool rebuildVs = rebuildAll || std::any_of(vsDependencies.begin(), vsDependencies.end(), affected);
+    if (rebuildAll) {
+        if (!exists(preludePath_)) {
+            return;
+        }
+        compiler_ = std::make_unique<DivFxCompiler>(assetRoot_, SlurpTextFile(preludePath_), profile_);
+    }
+    if (rebuildVs && compiler_->CompileVertexShader()) {
+        for (auto &layer : atlasCards_) {
+            layer->SetVertexShader(compiler_->VSBytecode());
+        }
+    }
+
+    int reloaded = 0;
+    for (size_t i = 0; i < sources_.size(); ++i) {
+        auto &source = sources_[i];
+        if (!rebuildAll && std::none_of(source.dependencies.begin(), source.dependencies.end(), affected)) {
+            continue;
+        }
+        auto var = CompileVariant(source, Fragment(assetRoot_ / source.desc->fragment));
+        if (!var.ps) {
+            fmt::print("Keeping the previous shader for {}.\n", names_[i]);
+            continue;
+        }
+        atlasCards_[i]->SetPixelShader(var);
+        ++reloaded;
+    }
+    auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+    fmt::print("Reloaded {} of {} layer shaders in {:.0f} ms.\n", reloaded, sources_.size(), elapsed.count());
+}
+
+std::vector<std::string> CardLayers::LayersWithoutShaders() const {
+    std::vector<std::string> ret;
+    for (size_t i = 0; i < atlasCards_.size(); ++i) {
+        if (!atlasCards_[i] || !atlasCards_[i]->HasPixelShader()) {
+            ret.push_back(names_[i]);
+        }
+    }
+    return ret;
+}
+
+void CardLayers::ReportMemory(MemoryReport &report) const {
+    dx_.ReportMemory(report);
+    for (size_t i = 0; i < atlasCards_.size(); ++i) {
+        atlasCards_[i]->ReportMemory(report, names_[i]);
+    }
+}
+
+std::vector<std::shared_ptr<CardLayer>> CardLayers::BuildLayerVariants(std::vector<LayerDesc const *> const &descs) {
+    std::vector<std::shared_ptr<CardLayer>> ret;
+    if (descs.empty()) {
+        return ret;
+    }
+    LayerSource source{.desc = descs[0]};
+    auto var = CompileVariant(source, Fragment(assetRoot_ / descs[0]->fragment));
+    if (!var.ps) {
+        return ret;
+    }
+    for (auto *desc : descs) {
+        var.desc = desc;
+        ret.push_back(MakeLayer(var));
+    }
+    return ret;
+}
+
+std::shared_ptr<CardLayer> CardLayers::MakeLayer(CardLayerVariant const &variant) {
+    switch (variant.desc->kind) {
+    case LayerKind::Draw2D:
+        return std::make_shared<Draw2DLayer>(dx_, *compiler_, variant);
+    case LayerKind::AtlasEffects:
+        return std::make_shared<AtlasEffectsLayer>(dx_, *compiler_, variant);
+    }
+    return nullptr;
+}
+
+std::string const &CardLayers::Fragment(std::filesystem::path const &path) {
+    auto &fragment = fragments_[PathKey(path)];
+    if (fragment.empty() && exists(path)) {
+        fragment = SlurpTextFile(path);
+    }
+    return fragment;
+}
+
+CardLayerVariant CardLayers::CompileVariant(LayerSource &source, std::string const &fragment) {
+    auto &desc = *source.desc;
+    DivFx dfx = compiler_->Compile(fragment, desc.entrypoint, desc.Specialization());
+    specializationFallbacks_ += dfx.unspecialized;
+
+    CardLayerVariant var{.desc = &desc};
+    if (dfx.psBytecode) {
+        HRESULT hr = dx_.dev->CreatePixelShader(dfx.psBytecode->GetBufferPointer(),
+                                                dfx.psBytecode->GetBufferSize(), nullptr, &var.ps);
+    }
+    var.bindings = std::make_shared<ShaderBindings>(dfx.psBytecode);
+
+    source.dependencies = std::move(dfx.includes);
+    source.dependencies.push_back((assetRoot_ / desc.fragment).lexically_normal());
+    return var;
+}
+
+std::string ComboName(std::vector<int> const &spec) {
+    std::string compositeName = "div_bg";
+    for (auto layerSource : spec) {
+        compositeName = fmt::format("{}_{}", compositeName, layerSource);
+    }
+    return compositeName;
+}
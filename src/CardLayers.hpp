@@ -0,0 +1,70 @@
+#pragma once
+
+#include "Cards.hpp"
+#include "D3D.hpp"
+#include "LayerDesc.hpp"
+#include "MemoryStats.hpp"
+
+#include <atomic>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+// Every layer of a catalog, compiled and ready to draw, with the combos that stack them into backgrounds.
+struct CardLayers {
+    explicit CardLayers(Dx &dx, std::filesystem::path preludePath, std::filesystem::path assetRoot,
+                        LayerCatalog const &catalog, ShaderProfile profile);
+
+    // Directories holding the prelude, the fragments and everything they include.
+    std::set<std::filesystem::path> WatchedDirectories() const;
+    // The prelude, the vertex shader, the fragments and everything they include, sorted.
+    std::vector<std::filesystem::path> ShaderSources() const;
+
+    // Recompiles the layers depending on any of the changed files and swaps their shaders in place. A change to the
+    // vertex shader's files recompiles it and only the layers that include them; a change to the prelude rebuilds the
+    // compiler and every layer. Textures stay loaded either way. Shaders that fail to compile keep running the old
+    // ones.
+    void Reload(std::vector<std::filesystem::path> const &changed);
+
+    void ReportMemory(MemoryReport &report) const;
+
+    // Names of the layers with no compiled pixel shader, which draw nothing.
+    std::vector<std::string> LayersWithoutShaders() const;
+
+    // Layer compiles whose specialized shader failed and that run the unspecialized one, since startup.
+    int SpecializationFallbacks() const { return specializationFallbacks_; }
+
+    // Builds one layer per description, all running the shader compiled for the first. The descriptions may only
+    // differ in parameters that are not compiled into the shader, and have to outlive the layers.
+    std::vector<std::shared_ptr<CardLayer>> BuildLayerVariants(std::vector<LayerDesc const *> const &descs);
+
+    Dx &dx_;
+    std::vector<std::shared_ptr<CardLayer>> atlasCards_;
+    std::vector<std::string> names_;
+    std::vector<std::vector<int>> combos_;
+
+  private:
+    struct LayerSource {
+        LayerDesc const *desc;
+        std::vector<std::filesystem::path> dependencies; // the fragment and its includes, from the last compile
+    };
+
+    // Fragment text by file, read once and shared by the layers using it. Not safe to call concurrently.
+    std::string const &Fragment(std::filesystem::path const &path);
+
+    std::shared_ptr<CardLayer> MakeLayer(CardLayerVariant const &variant);
+    CardLayerVariant CompileVariant(LayerSource &source, std::string const &fragment);
+
+    std::filesystem::path preludePath_, assetRoot_;
+    ShaderProfile profile_;
+    std::unique_ptr<DivFxCompiler> compiler_;
+    std::vector<LayerSource> sources_;
+    std::map<std::string, std::string> fragments_; // fragment text by PathKey, shared by layers using one file
+    std::atomic<int> specializationFallbacks_{};
+};
+
+// Name of the exported files of a combo, from the indices of its layers.
+std::string ComboName(std::vector<int> const &spec);
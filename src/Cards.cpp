@@ -1,9 +1,10 @@
 #include "Cards.hpp"
 
 #include <d3dcompiler.h>
+#include <fmt/format.h>
 #include <glm/gtc/type_ptr.hpp>
 
-#include <map>
+#include <algorithm>
 #include <span>
 #include <string>
 
@@ -16,20 +17,9 @@ struct UiVertex {
 
 CardLayer::CardLayer(Dx &dx, DivFxCompiler const &divFxCompiler) : dx_(dx), vsCbCpu_{} {
     HRESULT hr{S_OK};
-    D3D11_INPUT_ELEMENT_DESC ieds[]{
-        {"POSITION", 0, DXGI_FORMAT_R32G32_FLOAT, 0, offsetof(UiVertex, pos), D3D11_INPUT_PER_VERTEX_DATA, 0},
-        {"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, offsetof(UiVertex, uv), D3D11_INPUT_PER_VERTEX_DATA, 0},
-        {"COLOR", 0, DXGI_FORMAT_B8G8R8A8_UNORM, 0, offsetof(UiVertex, color), D3D11_INPUT_PER_VERTEX_DATA, 0},
-        {"TEXCOORD", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, offsetof(UiVertex, satScaleLocalUv),
-         D3D11_INPUT_PER_VERTEX_DATA, 0},
-    };
 
     {
-        auto bytecode = divFxCompiler.VSBytecode();
-        hr = dx.dev->CreateInputLayout(std::data(ieds), std::size(ieds), bytecode->GetBufferPointer(),
-                                       bytecode->GetBufferSize(), &il_);
-
-        hr = dx.dev->CreateVertexShader(bytecode->GetBufferPointer(), bytecode->GetBufferSize(), nullptr, &vs_);
+        SetVertexShader(divFxCompiler.VSBytecode());
 
         {
             D3D11_BUFFER_DESC vbd{
@@ -115,23 +105,68 @@ void CardLayer::SetViewTransform(glm::mat4 transform) {
     vsCbDirty_ = true;
 }
 
+namespace {
+void WriteQuad(UiVertex *verts, glm::ivec2 pos, glm::ivec2 size) {
+    for (int row = 0; row < 2; ++row) {
+        for (int col = 0; col < 2; ++col) {
+            auto &v = verts[col + row * 2];
+            glm::vec2 fpos = pos, fsize = size;
+            v.pos = glm::mix(fpos, fpos + fsize, glm::vec2{col, row});
+            v.uv = glm::vec2(col, row);
+            v.color = glm::u8vec4(255, 255, 255, 255);
+            v.satScaleLocalUv = glm::vec4(1.0f, 1.0f, v.uv);
+        }
+    }
+}
+} // namespace
+
 void CardLayer::Draw(glm::ivec2 pos, glm::ivec2 size) {
+    UiVertex verts[4]{};
+    WriteQuad(verts, pos, size);
+    dx_.ctx->UpdateSubresource(vb_, 0, nullptr, std::data(verts), 0, 0);
+    BindVertexStage(vb_);
+}
+
+void CardLayer::DrawBatch(std::span<CardInstance const> cards) {
     auto &ctx = dx_.ctx;
+    if (cards.empty()) {
+        return;
+    }
 
-    {
-        UiVertex verts[4]{};
-        for (int row = 0; row < 2; ++row) {
-            for (int col = 0; col < 2; ++col) {
-                auto &v = verts[col + row * 2];
-                glm::vec2 fpos = pos, fsize = size;
-                v.pos = glm::mix(fpos, fpos + fsize, glm::vec2{col, row});
-                v.uv = glm::vec2(col, row);
-                v.color = glm::u8vec4(255, 255, 255, 255);
-                v.satScaleLocalUv = glm::vec4(1.0f, 1.0f, v.uv);
-            }
-        }
-        dx_.ctx->UpdateSubresource(vb_, 0, nullptr, std::data(verts), 0, 0);
+    if (batchVbCapacity_ < cards.size()) {
+        batchVbCapacity_ = (std::max)(cards.size(), 2 * batchVbCapacity_);
+        D3D11_BUFFER_DESC vbd{
+            .ByteWidth = (UINT)(sizeof(UiVertex) * 4 * batchVbCapacity_),
+            .Usage = D3D11_USAGE_DYNAMIC,
+            .BindFlags = D3D11_BIND_VERTEX_BUFFER,
+            .CPUAccessFlags = D3D11_CPU_ACCESS_WRITE,
+        };
+        batchVb_.Release();
+        dx_.dev->CreateBuffer(&vbd, nullptr, &batchVb_);
     }
+    D3D11_MAPPED_SUBRESOURCE mapped{};
+    if (FAILED(ctx->Map(batchVb_, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped))) {
+        return;
+    }
+    for (size_t i = 0; i < cards.size(); ++i) {
+        WriteQuad((UiVertex *)mapped.pData + 4 * i, cards[i].pos, cards[i].size);
+    }
+    ctx->Unmap(batchVb_, 0);
+
+    BindVertexStage(batchVb_);
+    ctx->PSSetShader(ps_, nullptr, 0);
+    ctx->PSSetShaderResources(0, std::size(srvSlots_), std::data(srvSlots_));
+    ctx->PSSetSamplers(0, std::size(dx_.samplers), std::data(dx_.samplers));
+    for (size_t i = 0; i < cards.size(); ++i) {
+        SetTime(cards[i].time);
+        UploadPsCb();
+        ctx->PSSetConstantBuffers(0, 1, &psCb_.p);
+        ctx->DrawIndexed(6, 0, (INT)(4 * i));
+    }
+}
+
+void CardLayer::BindVertexStage(ID3D11Buffer *vb) {
+    auto &ctx = dx_.ctx;
 
     if (vsCbDirty_) {
         ctx->UpdateSubresource(vsCb_, 0, nullptr, &vsCbCpu_, 0, 0);
@@ -146,12 +181,27 @@ void CardLayer::Draw(glm::ivec2 pos, glm::ivec2 size) {
 
     ctx->IASetIndexBuffer(ib_, DXGI_FORMAT_R16_UINT, 0);
     UINT vtxStride = sizeof(UiVertex), vtxOffset = 0;
-    ctx->IASetVertexBuffers(0, 1, &vb_.p, &vtxStride, &vtxOffset);
+    ctx->IASetVertexBuffers(0, 1, &vb, &vtxStride, &vtxOffset);
 
     ctx->VSSetShader(vs_, nullptr, 0);
     ctx->VSSetConstantBuffers(0, 1, &vsCb_.p);
 }
 
+void CardLayer::ReportMemory(MemoryReport &report, std::string const &name) const {
+    uint64_t textureBytes = 0;
+    for (auto &srv : srvStorage_) {
+        if (srv) {
+            CComPtr<ID3D11Resource> resource;
+            srv->GetResource(&resource);
+            textureBytes += ResourceBytes(resource);
+        }
+    }
+    report.Attribute("layer textures", name, textureBytes);
+    report.Add("buffer", name,
+               ResourceBytes(vb_) + ResourceBytes(batchVb_) + ResourceBytes(ib_) + ResourceBytes(vsCb_) +
+                   ResourceBytes(psCb_));
+}
+
 void CardLayer::SetPsCbData(void const *data, size_t size) {
     HRESULT hr{S_OK};
 
@@ -159,6 +209,13 @@ void CardLayer::SetPsCbData(void const *data, size_t size) {
         return;
     }
 
+    // Each layer type has one cbuffer layout, so once created the buffer is only ever updated in place.
+    if (psCb_ && data) {
+        dx_.ctx->UpdateSubresource(psCb_, 0, nullptr, data, 0, 0);
+        psCbDirty_ = false;
+        return;
+    }
+
     D3D11_BUFFER_DESC cbd{
         .ByteWidth = (UINT)size,
         .Usage = D3D11_USAGE_DEFAULT,
@@ -172,103 +229,117 @@ void CardLayer::SetPsCbData(void const *data, size_t size) {
     psCbDirty_ = false;
 }
 
-void CardLayer::AddTexture(std::string_view name, std::string_view path, bool viewAsSrgb) {
-    if (auto slotI = texSlotByName_.find((std::string)name); slotI != texSlotByName_.end()) {
-        Dx::LoadTextureResult res;
-        CComPtr<ID3D11ShaderResourceView> srv;
-        if (!path.empty()) {
-            res = dx_.LoadTexture(path, viewAsSrgb);
-            srv = res.srv;
-        }
-        SrvBind bind{.slot = slotI->second, .srv{srv}};
-        psSrvs_.push_back(bind);
+void CardLayer::SetVertexShader(ID3DBlob *bytecode) {
+    if (!bytecode) {
+        return;
     }
+    D3D11_INPUT_ELEMENT_DESC ieds[]{
+        {"POSITION", 0, DXGI_FORMAT_R32G32_FLOAT, 0, offsetof(UiVertex, pos), D3D11_INPUT_PER_VERTEX_DATA, 0},
+        {"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, offsetof(UiVertex, uv), D3D11_INPUT_PER_VERTEX_DATA, 0},
+        {"COLOR", 0, DXGI_FORMAT_B8G8R8A8_UNORM, 0, offsetof(UiVertex, color), D3D11_INPUT_PER_VERTEX_DATA, 0},
+        {"TEXCOORD", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, offsetof(UiVertex, satScaleLocalUv),
+         D3D11_INPUT_PER_VERTEX_DATA, 0},
+    };
+    il_.Release();
+    vs_.Release();
+    HRESULT hr = dx_.dev->CreateInputLayout(std::data(ieds), std::size(ieds), bytecode->GetBufferPointer(),
+                                            bytecode->GetBufferSize(), &il_);
+    hr = dx_.dev->CreateVertexShader(bytecode->GetBufferPointer(), bytecode->GetBufferSize(), nullptr, &vs_);
 }
 
-void CardLayer::GenTexture(std::string_view name, glm::ivec2 size, uint32_t value) {
-    if (auto slotI = texSlotByName_.find((std::string)name); slotI != texSlotByName_.end()) {
-        std::vector<uint32_t> data(size.x * size.y, value);
-        UINT pitch = 4 * size.x;
-        UINT slicePitch = pitch * size.y;
-
-        CComPtr<ID3D11Texture2D> tex;
-        D3D11_TEXTURE2D_DESC td{.Width = (UINT)size.x,
-                                .Height = (UINT)size.y,
-                                .MipLevels = 0,
-                                .ArraySize = 1,
-                                .Format = DXGI_FORMAT_B8G8R8A8_UNORM,
-                                .SampleDesc = {1, 0},
-                                .Usage = D3D11_USAGE_DEFAULT,
-                                .BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE,
-                                .MiscFlags = 0};
-        glm::ivec2 shrink = size;
-        std::vector<D3D11_SUBRESOURCE_DATA> srds;
-        while (true) {
-            srds.push_back(
-                D3D11_SUBRESOURCE_DATA{.pSysMem = data.data(), .SysMemPitch = pitch, .SysMemSlicePitch = slicePitch});
-            if (shrink == glm::ivec2{1, 1}) {
-                break;
-            }
-            shrink = (glm::max)(shrink / 2, {1, 1});
+void CardLayer::BindLayer(LayerDesc const &desc, ShaderBindings const &bindings, void *psCb, size_t psCbSize) {
+    srvStorage_.clear();
+    srvSlots_.clear();
+    for (auto &texDesc : desc.textures) {
+        auto slot = bindings.TextureSlot(texDesc.name);
+        if (!slot) {
+            continue;
         }
-        dx_.dev->CreateTexture2D(&td, srds.data(), &tex);
-
         CComPtr<ID3D11ShaderResourceView> srv;
-        dx_.dev->CreateShaderResourceView(tex, nullptr, &srv);
+        if (texDesc.solid) {
+            srv = dx_.SolidTexture(texDesc.width, texDesc.height, texDesc.color).srv;
+        } else if (!texDesc.path.empty()) {
+            srv = dx_.LoadTexture(texDesc.path, texDesc.srgb, LayerFootprint(desc)).srv;
+        }
+        if (*slot >= srvStorage_.size()) {
+            srvStorage_.resize(*slot + 1);
+        }
+        srvStorage_[*slot] = srv;
+    }
+    for (auto &srv : srvStorage_) {
+        srvSlots_.push_back(srv.p);
+    }
 
-        SrvBind bind{.slot = slotI->second, .srv{srv}};
-        psSrvs_.push_back(bind);
+    for (auto &param : desc.params) {
+        auto offset = bindings.FieldOffset(param.field);
+        size_t size = 4 * param.components;
+        if (!offset || *offset + size > psCbSize) {
+            fmt::print("Layer {} parameter {} does not match the shader cbuffer.\n", desc.name, param.field);
+            continue;
+        }
+        memcpy((uint8_t *)psCb + *offset, param.bits.data(), size);
     }
+    psCbDirty_ = true;
 }
 
-void CardLayer::ReflectPixelShader(CComPtr<ID3DBlob> bytecode) {
+ShaderBindings::ShaderBindings(ID3DBlob *bytecode) {
+    if (!bytecode) {
+        return;
+    }
     CComPtr<ID3D11ShaderReflection> refl;
     HRESULT hr = D3DReflect(bytecode->GetBufferPointer(), bytecode->GetBufferSize(), IID_PPV_ARGS(&refl));
+    if (FAILED(hr)) {
+        return;
+    }
     D3D11_SHADER_DESC desc{};
     hr = refl->GetDesc(&desc);
     for (UINT resIdx = 0; resIdx < desc.BoundResources; ++resIdx) {
         D3D11_SHADER_INPUT_BIND_DESC inputBindDesc{};
         hr = refl->GetResourceBindingDesc(resIdx, &inputBindDesc);
         if (inputBindDesc.Type == D3D_SIT_TEXTURE) {
-            texNameBySlot_[inputBindDesc.BindPoint] = inputBindDesc.Name;
-            texSlotByName_[inputBindDesc.Name] = inputBindDesc.BindPoint;
+            textures_.push_back({inputBindDesc.Name, inputBindDesc.BindPoint});
+        }
+    }
+    if (desc.ConstantBuffers > 0) {
+        auto *cb = refl->GetConstantBufferByIndex(0);
+        D3D11_SHADER_BUFFER_DESC cbDesc{};
+        cb->GetDesc(&cbDesc);
+        for (UINT varIdx = 0; varIdx < cbDesc.Variables; ++varIdx) {
+            D3D11_SHADER_VARIABLE_DESC varDesc{};
+            cb->GetVariableByIndex(varIdx)->GetDesc(&varDesc);
+            fields_.push_back({varDesc.Name, varDesc.StartOffset});
         }
     }
 }
 
-void CardLayer::ResolveTextureBindings() {
-    srvSlots_.clear();
-    for (auto &bind : psSrvs_) {
-        if (bind.slot >= srvSlots_.size()) {
-            srvSlots_.resize(bind.slot + 1);
+std::optional<UINT> ShaderBindings::TextureSlot(std::string_view name) const {
+    for (auto &binding : textures_) {
+        if (binding.name == name) {
+            return binding.index;
         }
-        srvSlots_[bind.slot] = bind.srv.p;
     }
+    return std::nullopt;
 }
 
-AtlasEffectsLayer::AtlasEffectsLayer(Dx &dx, DivFxCompiler &divFxCompiler, AtlasEffectsVariant const &variant)
-    : CardLayer(dx, divFxCompiler), ps_(variant.ps) {
-    psCbCpu_ = PsCbData{
-        .time = 36.001f,
-        .image_width = 390.0f,
-        .image_height = 280.0f,
-        .progress = 0.0f,
-        .alpha = 0.0f,
-        .bonus_completed = 0.0f,
-        .num_segments = 0,
-        .radians_per_second = 0.0f,
-        .doubled_memory_line_segments = FALSE,
-        .num_memory_line_textures = 0,
-        .memory_line_texture_datas{},
-        .memory_line_texture_uvs{},
-    };
-
-    ReflectPixelShader(variant.psBytecode);
+std::optional<UINT> ShaderBindings::FieldOffset(std::string_view field) const {
+    // Specialized fields keep their slot under a padding name, see ShaderSpecialization.
+    auto specialized = fmt::format("divfx_specialized_{}", field);
+    for (auto &binding : fields_) {
+        if (binding.name == field || binding.name == specialized) {
+            return binding.index;
+        }
+    }
+    return std::nullopt;
+}
 
-    AddTexture("tex", "Art/2DArt/UIEffects/ConquerorItems/paperBG.dds");
-    AddTexture("noise_map", "Art/2DArt/Lookup/atlas_lookup.dds");
+AtlasEffectsLayer::AtlasEffectsLayer(Dx &dx, DivFxCompiler &divFxCompiler, CardLayerVariant const &variant)
+    : CardLayer(dx, divFxCompiler), psCbCpu_{} {
+    SetPixelShader(variant);
+}
 
-    ResolveTextureBindings();
+void AtlasEffectsLayer::SetPixelShader(CardLayerVariant const &variant) {
+    ps_ = variant.ps;
+    BindLayer(*variant.desc, *variant.bindings, &psCbCpu_, sizeof(psCbCpu_));
 }
 
 void AtlasEffectsLayer::SetTime(double time) {
@@ -276,11 +347,13 @@ void AtlasEffectsLayer::SetTime(double time) {
     psCbDirty_ = true;
 }
 
+void AtlasEffectsLayer::UploadPsCb() { SetPsCbData(&psCbCpu_, sizeof(psCbCpu_)); }
+
 void AtlasEffectsLayer::Draw(glm::ivec2 pos, glm::ivec2 size) {
     CardLayer::Draw(pos, size);
     auto &ctx = dx_.ctx;
 
-    SetPsCbData(&psCbCpu_, sizeof(psCbCpu_));
+    UploadPsCb();
 
     ctx->PSSetShader(ps_, nullptr, 0);
 
@@ -290,75 +363,14 @@ void AtlasEffectsLayer::Draw(glm::ivec2 pos, glm::ivec2 size) {
     ctx->DrawIndexed(6, 0, 0);
 }
 
-Draw2DLayer::Draw2DLayer(Dx &dx, DivFxCompiler &divFxCompiler, Draw2DVariant const &variant)
-    : CardLayer(dx, divFxCompiler), ps_(variant.ps) {
-    HRESULT hr{S_OK};
-    psCbCpu_ = {
-        .time = 23.762f,
-        .seed = 0.0f,
-        .effect_phase = 0.0f,
-        .to_base_resolution_multiplier = 0.0f,
-        .has_mask = 1.0f,
-        .has_background = 1.0f,
-        .is_div_card = 1.0f,
-        .aspect_ratio = {1.39286f, 1.0f, 0.0f, 0.0f},
-        .tex_scale = {6.96429f, 5.0f, 0.0f, 0.0f},
-        .muddle_intensity = {0.1f, 0.1f, 0.0f, 0.0f},
-        .tex_clamp{},
-        .effect_params{},
-        .layers_count = 0.0f,
-        .item_size{},
-        .flash_glow_color{},
-        .hellscape_params{},
-        .layer_0_speed = {0.0075f, 0.0025f, 0.0f, 0.0f},
-        .layer_1_speed = {0.0225f, 0.0075f, 0.0f, 0.0f},
-        .layer_2_speed = {0.03f, 0.01f, 0.0f, 0.0f},
-        .layer_3_speed{},
-    };
-
-    if (variant.name == "shaper") {
-        psCbCpu_.muddle_frequency = 10.0f;
-        psCbCpu_.shader_type = 2.0f;
-    } else if (variant.name == "elder") {
-        psCbCpu_.muddle_frequency = 1.0f;
-        psCbCpu_.shader_type = 0.0f;
-    }
-
-    ReflectPixelShader(variant.psBytecode);
-
-    AddTexture("tex", "Art/2DArt/UIEffects/ConquerorItems/paperBG.dds", true);
-    GenTexture("mask_tex", {1, 1}, 0x7DFFFFFFu); // add 1x1 0x7DFFFFFF texture here
-    if (variant.name == "shaper") {
-        AddTexture("color_layer_0_tex", "Art/2DArt/Tentacles/ShaperAreaColor1.dds", true);
-        AddTexture("color_layer_1_tex", "Art/2DArt/Tentacles/ShaperAreaColor2.dds", true);
-        AddTexture("color_layer_2_tex", "Art/2DArt/Tentacles/ShaperAreaColor3.dds", true);
-        AddTexture("color_layer_3_tex", {}, true);
-        AddTexture("influence_layer_0_tex", "Art/2DArt/Tentacles/ShaperAreaNormal1.dds");
-        AddTexture("influence_layer_1_tex", "Art/2DArt/Tentacles/ShaperAreaNormal2.dds");
-        AddTexture("influence_layer_2_tex", "Art/2DArt/Tentacles/ShaperAreaNormal3.dds");
-        AddTexture("influence_layer_3_tex", {});
-        AddTexture("mask_layer_0_tex", {});
-        AddTexture("mask_layer_1_tex", {});
-        AddTexture("mask_layer_2_tex", {});
-        AddTexture("mask_layer_3_tex", {});
-    } else if (variant.name == "elder") {
-        AddTexture("color_layer_0_tex", "Art/2DArt/Tentacles/PeopleBackground.dds", true);
-        AddTexture("color_layer_1_tex", "Art/2DArt/Tentacles/PeopleTentacleColor1.dds", true);
-        AddTexture("color_layer_2_tex", "Art/2DArt/Tentacles/PeopleTentacleColor2.dds", true);
-        AddTexture("color_layer_3_tex", "Art/2DArt/Tentacles/PeopleTentacleColor3.dds", true);
-        GenTexture("influence_layer_0_tex", {16, 16}, 0xFF000000u); // add 16x16 0xFF000000 texture here
-        AddTexture("influence_layer_1_tex", "Art/2DArt/Tentacles/PeopleTentacleInfluence.dds");
-        AddTexture("influence_layer_2_tex", "Art/2DArt/Tentacles/PeopleTentacleInfluence.dds");
-        AddTexture("influence_layer_3_tex", "Art/2DArt/Tentacles/PeopleTentacleInfluence.dds");
-        GenTexture("mask_layer_0_tex", {16, 16}, 0xFFFFFFFF); // add 16x16 0xFFFFFFFF texture here
-        AddTexture("mask_layer_1_tex", "Art/2DArt/Tentacles/PeopleTentacleMask1.dds");
-        AddTexture("mask_layer_2_tex", "Art/2DArt/Tentacles/PeopleTentacleMask2.dds");
-        AddTexture("mask_layer_3_tex", "Art/2DArt/Tentacles/PeopleTentacleMask3.dds");
-    }
-    AddTexture("muddle_tex", "Art/2DArt/Lookup/muddle.dds");
-    AddTexture("background_tex", "Art/2DArt/Atlas/AtlasCompletelyBlank.dds", true);
+Draw2DLayer::Draw2DLayer(Dx &dx, DivFxCompiler &divFxCompiler, CardLayerVariant const &variant)
+    : CardLayer(dx, divFxCompiler), psCbCpu_{} {
+    SetPixelShader(variant);
+}
 
-    ResolveTextureBindings();
+void Draw2DLayer::SetPixelShader(CardLayerVariant const &variant) {
+    ps_ = variant.ps;
+    BindLayer(*variant.desc, *variant.bindings, &psCbCpu_, sizeof(psCbCpu_));
 }
 
 void Draw2DLayer::SetTime(double time) {
@@ -366,11 +378,13 @@ void Draw2DLayer::SetTime(double time) {
     psCbDirty_ = true;
 }
 
+void Draw2DLayer::UploadPsCb() { SetPsCbData(&psCbCpu_, sizeof(psCbCpu_)); }
+
 void Draw2DLayer::Draw(glm::ivec2 pos, glm::ivec2 size) {
     CardLayer::Draw(pos, size);
     auto &ctx = dx_.ctx;
 
-    SetPsCbData(&psCbCpu_, sizeof(psCbCpu_));
+    UploadPsCb();
 
     ctx->PSSetShader(ps_, nullptr, 0);
     ctx->PSSetShaderResources(0, std::size(srvSlots_), std::data(srvSlots_));
@@ -1,9 +1,12 @@
 #pragma once
 
 #include "D3D.hpp"
+#include "LayerDesc.hpp"
 #include <glm/glm.hpp>
 
-#include <map>
+#include <memory>
+#include <optional>
+#include <span>
 #include <string_view>
 #include <string>
 
@@ -12,6 +15,47 @@ enum CardSize {
     eCardHeight = 280,
 };
 
+// Maps pixel coordinates with a top-left origin to clip space, for CardLayer::SetViewTransform.
+inline glm::mat4 UiMatrix(glm::ivec2 uiSize) {
+    return glm::mat4{{2.0f / uiSize.x, 0, 0, 0},  //
+                     {0, -2.0f / uiSize.y, 0, 0}, //
+                     {0, 0, 1, 0},                //
+                     {-1, 1, 0, 1}};
+}
+
+// How a layer draws its textures across a card, for trimming mips it can never sample.
+inline TextureFootprint LayerFootprint(LayerDesc const &desc) {
+    return {.width = eCardWidth, .height = eCardHeight, .minUvScale = desc.MinUvScale()};
+}
+
+// Texture slots and cbuffer field offsets of a compiled pixel shader, reflected once per variant and only consulted
+// while layers are built.
+struct ShaderBindings {
+    explicit ShaderBindings(ID3DBlob *bytecode);
+
+    std::optional<UINT> TextureSlot(std::string_view name) const;
+    std::optional<UINT> FieldOffset(std::string_view field) const;
+
+  private:
+    struct Binding {
+        std::string name;
+        UINT index;
+    };
+    std::vector<Binding> textures_, fields_;
+};
+
+struct CardLayerVariant {
+    LayerDesc const *desc;
+    CComPtr<ID3D11PixelShader> ps;
+    std::shared_ptr<ShaderBindings const> bindings;
+};
+
+// One card drawn by CardLayer::DrawBatch.
+struct CardInstance {
+    glm::ivec2 pos, size;
+    double time;
+};
+
 struct CardLayer {
     CardLayer(Dx &dx, DivFxCompiler const &divFxCompiler);
     virtual ~CardLayer() = default;
@@ -20,13 +64,25 @@ struct CardLayer {
 
     virtual void SetTime(double time) = 0;
     virtual void Draw(glm::ivec2 pos, glm::ivec2 size) = 0;
+    // Draws the layer on many cards, each at its own position and time. State and textures are bound once and one
+    // vertex buffer holds every quad, leaving a cbuffer update and a draw per card.
+    void DrawBatch(std::span<CardInstance const> cards);
+
+    // Replaces the shaders of a live layer after a recompile, rebinding textures and parameters to the new reflection.
+    void SetVertexShader(ID3DBlob *bytecode);
+    virtual void SetPixelShader(CardLayerVariant const &variant) = 0;
+    // False when the layer's shader never compiled and it draws nothing.
+    bool HasPixelShader() const { return ps_ != nullptr; }
+
+    // Reports the layer's own buffers, and attributes the shared textures it binds to it.
+    void ReportMemory(MemoryReport &report, std::string const &name) const;
 
   protected:
     void SetPsCbData(void const *data, size_t size);
-    void AddTexture(std::string_view name, std::string_view path, bool viewAsSrgb = false);
-    void GenTexture(std::string_view name, glm::ivec2 size, uint32_t value);
-    void ResolveTextureBindings();
-    void ReflectPixelShader(CComPtr<ID3DBlob> bytecode);
+    virtual void UploadPsCb() = 0;
+    void BindVertexStage(ID3D11Buffer *vb);
+    // Resolves the layer's textures into srvSlots_ and writes its parameter defaults into the cbuffer image.
+    void BindLayer(LayerDesc const &desc, ShaderBindings const &bindings, void *psCb, size_t psCbSize);
 
     struct VsCbData {
         glm::mat4 uiScale;
@@ -40,34 +96,28 @@ struct CardLayer {
     CComPtr<ID3D11RasterizerState> divRaster_;
     CComPtr<ID3D11BlendState> divBlend_;
     CComPtr<ID3D11InputLayout> il_;
-    CComPtr<ID3D11Buffer> ib_, vb_;
+    CComPtr<ID3D11Buffer> ib_, vb_, batchVb_;
+    size_t batchVbCapacity_{}; // in quads
     CComPtr<ID3D11VertexShader> vs_;
+    CComPtr<ID3D11PixelShader> ps_;
     CComPtr<ID3D11Buffer> vsCb_, psCb_;
 
-    std::map<UINT, std::string> texNameBySlot_;
-    std::map<std::string, UINT> texSlotByName_;
-
-    struct SrvBind {
-        UINT slot;
-        CComPtr<ID3D11ShaderResourceView> srv;
-    };
-    std::vector<SrvBind> psSrvs_;
+    // Flat table indexed by shader slot, handed to PSSetShaderResources as is.
+    std::vector<CComPtr<ID3D11ShaderResourceView>> srvStorage_;
     std::vector<ID3D11ShaderResourceView *> srvSlots_;
 };
 
-struct AtlasEffectsVariant {
-    std::string name;
-    CComPtr<ID3D11PixelShader> ps;
-    CComPtr<ID3DBlob> psBytecode;
-};
-
 struct AtlasEffectsLayer : CardLayer {
-    AtlasEffectsLayer(Dx &dx, DivFxCompiler &divFxCompiler, AtlasEffectsVariant const &variant);
+    AtlasEffectsLayer(Dx &dx, DivFxCompiler &divFxCompiler, CardLayerVariant const &variant);
 
     void SetTime(double time) override;
+    void SetPixelShader(CardLayerVariant const &variant) override;
 
     void Draw(glm::ivec2 pos, glm::ivec2 size);
 
+  protected:
+    void UploadPsCb() override;
+
   private:
     enum { MAX_MEMORY_LINE_NODE_IMAGES = 5 };
     struct PsCbData {
@@ -92,23 +142,19 @@ struct AtlasEffectsLayer : CardLayer {
     };
 
     PsCbData psCbCpu_;
-    std::vector<CComPtr<ID3D11ShaderResourceView>> psSrvs_;
-    CComPtr<ID3D11PixelShader> ps_;
-};
-
-struct Draw2DVariant {
-    std::string name;
-    CComPtr<ID3D11PixelShader> ps;
-    CComPtr<ID3DBlob> psBytecode;
 };
 
 struct Draw2DLayer : CardLayer {
-    Draw2DLayer(Dx &dx, DivFxCompiler &divFxCompiler, Draw2DVariant const &variant);
+    Draw2DLayer(Dx &dx, DivFxCompiler &divFxCompiler, CardLayerVariant const &variant);
 
     void SetTime(double time) override;
+    void SetPixelShader(CardLayerVariant const &variant) override;
 
     void Draw(glm::ivec2 pos, glm::ivec2 size);
 
+  protected:
+    void UploadPsCb() override;
+
   private:
     struct PsCbData {
         float time;
@@ -144,5 +190,4 @@ struct Draw2DLayer : CardLayer {
     };
 
     PsCbData psCbCpu_;
-    CComPtr<ID3D11PixelShader> ps_;
 };
\ No newline at end of file
@@ -0,0 +1,124 @@
+#include "Checkpoint.hpp"
+#include "Util.hpp"
+
+#include <fmt/format.h>
+#include <fmt/xchar.h>
+
+#include <windows.h>
+
+#include <charconv>
+#include <fstream>
+#include <sstream>
+
+namespace {
+// Writes text to the journal and flushes it to disk, appending or replacing the file.
+bool WriteJournal(std::filesystem::path const &path, std::string const &text, bool append) {
+    HANDLE file = CreateFileW(path.c_str(), append ? FILE_APPEND_DATA : GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                              append ? OPEN_ALWAYS : CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    DWORD written{};
+    bool ok = file != INVALID_HANDLE_VALUE && WriteFile(file, text.data(), (DWORD)text.size(), &written, nullptr) &&
+              written == text.size() && FlushFileBuffers(file);
+    if (file != INVALID_HANDLE_VALUE) {
+        CloseHandle(file);
+    }
+    if (!ok) {
+        fmt::print(L"Checkpoint journal {} could not be written: {}\n", path.wstring(), GetLastError());
+    }
+    return ok;
+}
+
+std::optional<uint64_t> ParseHash(std::string const &text) {
+    uint64_t hash{};
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), hash, 16);
+    if (text.size() != 16 || ec != std::errc{} || ptr != text.data() + text.size()) {
+        return std::nullopt;
+    }
+    return hash;
+}
+} // namespace
+
+uint64_t HashBytes(void const *data, size_t size, uint64_t hash) {
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ ((uint8_t const *)data)[i]) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+std::optional<uint64_t> HashFiles(std::vector<std::filesystem::path> const &files, uint64_t hash) {
+    std::vector<char> buffer(1 << 16);
+    for (auto &path : files) {
+        std::ifstream is(path, std::ios::binary);
+        if (!is) {
+            return std::nullopt;
+        }
+        while (is.read(buffer.data(), buffer.size()) || is.gcount()) {
+            hash = HashBytes(buffer.data(), (size_t)is.gcount(), hash);
+        }
+    }
+    return hash;
+}
+
+std::optional<std::vector<CheckpointUnit>> ParseCheckpointJournal(std::string const &text, uint64_t fingerprint) {
+    std::istringstream is(text);
+    // fingerprint <hash>
+    std::string line, keyword, hashText, extra;
+    std::getline(is, line);
+    std::istringstream header(line);
+    if (!(header >> keyword >> hashText) || (header >> extra) || keyword != "fingerprint" ||
+        ParseHash(hashText) != fingerprint) {
+        return std::nullopt;
+    }
+    std::vector<CheckpointUnit> ret;
+    // <combo> <first frame> <last frame> <hash>
+    while (std::getline(is, line)) {
+        std::istringstream ls(line);
+        std::string combo;
+        int first{}, last{};
+        if (!(ls >> combo >> first >> last >> hashText) || (ls >> extra) || last < first) {
+            continue;
+        }
+        if (auto hash = ParseHash(hashText)) {
+            ret.push_back({combo, {first, last + 1}, *hash});
+        }
+    }
+    return ret;
+}
+
+CheckpointJournal::CheckpointJournal(std::filesystem::path path, uint64_t fingerprint) : path_(std::move(path)) {
+    if (exists(path_)) {
+        if (auto units = ParseCheckpointJournal(SlurpTextFile(path_), fingerprint)) {
+            for (auto &unit : *units) {
+                units_[{unit.combo, unit.frames.begin}] = {unit.frames.end, unit.hash};
+            }
+            return;
+        }
+        fmt::print("Checkpoint journal {} was written with other inputs or settings, starting over.\n",
+                   path_.string());
+    }
+    WriteJournal(path_, fmt::format("fingerprint {:016x}\n", fingerprint), false);
+}
+
+bool CheckpointJournal::Verified(std::string const &combo, IndexRange frames,
+                                 std::vector<std::filesystem::path> const &files) const {
+    auto I = units_.find({combo, frames.begin});
+    if (I == units_.end() || I->second.end != frames.end) {
+        return false;
+    }
+    auto hash = HashFiles(files);
+    return hash && *hash == I->second.hash;
+}
+
+bool CheckpointJournal::Record(std::string const &combo, IndexRange frames,
+                               std::vector<std::filesystem::path> const &files) {
+    auto hash = HashFiles(files);
+    if (!hash) {
+        fmt::print("Unit {} {}-{} has missing files and is not checkpointed.\n", combo, frames.begin, frames.end - 1);
+        return false;
+    }
+    auto line = fmt::format("{} {} {} {:016x}\n", combo, frames.begin, frames.end - 1, *hash);
+    if (!WriteJournal(path_, line, true)) {
+        return false;
+    }
+    units_[{combo, frames.begin}] = {frames.end, *hash};
+    return true;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "Shards.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+enum : uint64_t { eFnvOffsetBasis = 0xCBF29CE484222325ull };
+
+// FNV-1a hash of bytes, continuing from an earlier hash.
+uint64_t HashBytes(void const *data, size_t size, uint64_t hash = eFnvOffsetBasis);
+// FNV-1a hash of the contents of the files in order, or nothing if any of them cannot be read.
+std::optional<uint64_t> HashFiles(std::vector<std::filesystem::path> const &files, uint64_t hash = eFnvOffsetBasis);
+
+struct CheckpointUnit {
+    std::string combo;
+    IndexRange frames;
+    uint64_t hash;
+};
+
+// Units listed in journal text, which starts with the fingerprint of the run that wrote it. Nothing if the fingerprint
+// is missing or differs from the given one; lines torn by a crash are skipped.
+std::optional<std::vector<CheckpointUnit>> ParseCheckpointJournal(std::string const &text, uint64_t fingerprint);
+
+// Journal of the export units, blocks of frames of one combo, finished so far and the hash of their files. Each
+// finished unit is appended and flushed to disk, so an export that dies midway can be rerun and only redo the units
+// that were in flight. Every frame depends only on its own index, crossfade tail included, so a resumed unit renders
+// exactly what the interrupted run would have, as long as its inputs and settings are the same. The fingerprint of
+// those heads the journal, and a journal written with another one is started over.
+struct CheckpointJournal {
+    // Loads the units recorded by earlier runs with the same fingerprint, or starts a new journal.
+    CheckpointJournal(std::filesystem::path path, uint64_t fingerprint);
+
+    // Whether an earlier run finished the unit and its files still hash to what was recorded.
+    bool Verified(std::string const &combo, IndexRange frames, std::vector<std::filesystem::path> const &files) const;
+    // Hashes the unit's files and durably appends it to the journal.
+    bool Record(std::string const &combo, IndexRange frames, std::vector<std::filesystem::path> const &files);
+
+    size_t RecordedUnits() const { return units_.size(); }
+
+  private:
+    struct Unit {
+        int end;
+        uint64_t hash;
+    };
+
+    std::filesystem::path path_;
+    std::map<std::pair<std::string, int>, Unit> units_; // by combo and first frame
+};
@@ -0,0 +1,231 @@
+#include "Compositor.hpp"
+#include "Dds.hpp"
+
+#include <DirectXTex.h>
+#include <fmt/format.h>
+
+#include <emmintrin.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+std::wstring WidenUtf8(std::string const &text) {
+    std::wstring ret(MultiByteToWideChar(CP_UTF8, 0, text.data(), (int)text.size(), nullptr, 0), L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, text.data(), (int)text.size(), ret.data(), (int)ret.size());
+    return ret;
+}
+} // namespace
+
+void BlendOver(uint8_t *dst, uint8_t const *src, size_t pixels) {
+    size_t i = 0;
+    __m128i const zero = _mm_setzero_si128();
+    __m128i const c255 = _mm_set1_epi16(255);
+    __m128i const c128 = _mm_set1_epi16(128);
+    // x / 255 rounded, for x up to 255 * 255
+    auto div255 = [&](__m128i x) {
+        x = _mm_add_epi16(x, c128);
+        return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+    };
+    auto blendHalf = [&](__m128i s, __m128i d) {
+        __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        return _mm_add_epi16(s, div255(_mm_mullo_epi16(d, _mm_sub_epi16(c255, alpha))));
+    };
+    for (; i + 4 <= pixels; i += 4) {
+        __m128i s = _mm_loadu_si128((__m128i const *)(src + 4 * i));
+        __m128i d = _mm_loadu_si128((__m128i const *)(dst + 4 * i));
+        __m128i lo = blendHalf(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero));
+        __m128i hi = blendHalf(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero));
+        _mm_storeu_si128((__m128i *)(dst + 4 * i), _mm_packus_epi16(lo, hi));
+    }
+    for (; i < pixels; ++i) {
+        uint32_t inv = 255 - src[4 * i + 3];
+        for (int c = 0; c < 4; ++c) {
+            uint32_t x = dst[4 * i + c] * inv + 128;
+            dst[4 * i + c] = uint8_t((std::min)(src[4 * i + c] + ((x + (x >> 8)) >> 8), 255u));
+        }
+    }
+}
+
+CardCompositor::CardCompositor(CardLayout layout, std::vector<std::filesystem::path> resourceRoots)
+    : layout_(std::move(layout)), resourceRoots_(std::move(resourceRoots)) {
+    CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&wic_));
+    D2D1CreateFactory(D2D1_FACTORY_TYPE_SINGLE_THREADED, &d2d_);
+    DWriteCreateFactory(DWRITE_FACTORY_TYPE_SHARED, __uuidof(IDWriteFactory), (IUnknown **)&dwrite_);
+}
+
+std::optional<CardCompositor::Image> CardCompositor::LoadImage(std::string const &path, int width,
+                                                               int height) const {
+    for (auto &root : resourceRoots_) {
+        auto finalPath = root / path;
+        if (!exists(finalPath)) {
+            continue;
+        }
+        // Only the mips down to the smallest one still at least the target size are read; the resize starts there.
+        auto file = ReadDdsFile(finalPath, [&](uint64_t texWidth, uint64_t texHeight, uint32_t mips) {
+            double shrink = (std::min)((double)texWidth / width, (double)texHeight / height);
+            return shrink >= 2.0 ? (std::min)((uint32_t)std::log2(shrink), mips - 1) : 0u;
+        });
+        if (!file) {
+            break;
+        }
+        DirectX::TexMetadata meta{};
+        DirectX::ScratchImage loaded, decoded, converted, resized;
+        HRESULT hr = DirectX::LoadFromDDSMemory(file->data.data(), file->data.size(), DirectX::DDS_FLAGS_NONE, &meta,
+                                                loaded);
+        if (FAILED(hr)) {
+            break;
+        }
+        // Keep the stored bytes: the exported frames are sRGB-encoded too, so no color space conversion applies.
+        loaded.OverrideFormat(DirectX::MakeLinear(meta.format));
+        auto *image = loaded.GetImage(0, 0, 0);
+        if (DirectX::IsCompressed(image->format)) {
+            hr = DirectX::Decompress(*image, DXGI_FORMAT_R8G8B8A8_UNORM, decoded);
+            image = decoded.GetImage(0, 0, 0);
+        }
+        if (SUCCEEDED(hr) && image->format != DXGI_FORMAT_R8G8B8A8_UNORM) {
+            hr = DirectX::Convert(*image, DXGI_FORMAT_R8G8B8A8_UNORM, DirectX::TEX_FILTER_DEFAULT,
+                                  DirectX::TEX_THRESHOLD_DEFAULT, converted);
+            image = converted.GetImage(0, 0, 0);
+        }
+        if (SUCCEEDED(hr)) {
+            hr = DirectX::Resize(*image, width, height, DirectX::TEX_FILTER_CUBIC, resized);
+        }
+        DirectX::ScratchImage premultiplied;
+        if (SUCCEEDED(hr)) {
+            hr = DirectX::PremultiplyAlpha(*resized.GetImage(0, 0, 0), DirectX::TEX_PMALPHA_DEFAULT, premultiplied);
+        }
+        if (FAILED(hr)) {
+            break;
+        }
+        auto *result = premultiplied.GetImage(0, 0, 0);
+        Image ret{.width = width, .height = height};
+        ret.pixels.resize(4 * (size_t)width * height);
+        for (int y = 0; y < height; ++y) {
+            memcpy(ret.pixels.data() + 4 * (size_t)width * y, result->pixels + result->rowPitch * y, 4 * (size_t)width);
+        }
+        return ret;
+    }
+    fmt::print("Could not load card image {}.\n", path);
+    return std::nullopt;
+}
+
+CardCompositor::Image const *CardCompositor::SharedImage(std::string const &path, int width, int height) {
+    auto key = fmt::format("{}|{}x{}", path, width, height);
+    auto I = sharedImages_.find(key);
+    if (I == sharedImages_.end()) {
+        I = sharedImages_.emplace(key, LoadImage(path, width, height)).first;
+    }
+    return I->second ? &*I->second : nullptr;
+}
+
+void CardCompositor::BlendImage(Image const &image, PixelRect rect, FrameBuffer &overlay) const {
+    int x0 = (std::max)(rect.x, 0), x1 = (std::min)(rect.x + rect.width, (int)overlay.width);
+    int y0 = (std::max)(rect.y, 0), y1 = (std::min)(rect.y + rect.height, (int)overlay.height);
+    for (int y = y0; y < y1 && x0 < x1; ++y) {
+        auto *src = image.pixels.data() + 4 * ((size_t)(y - rect.y) * image.width + (x0 - rect.x));
+        BlendOver(overlay.Pixel(x0, y), src, x1 - x0);
+    }
+}
+
+bool CardCompositor::DrawTitle(std::string const &text, CardStaticLayer const &layer, FrameBuffer &overlay) {
+    if (!wic_ || !d2d_ || !dwrite_) {
+        return false;
+    }
+    auto &rect = layer.rect;
+    CComPtr<IWICBitmap> bitmap;
+    CComPtr<ID2D1RenderTarget> rt;
+    CComPtr<IDWriteTextFormat> format;
+    CComPtr<ID2D1SolidColorBrush> brush;
+    HRESULT hr = wic_->CreateBitmap(rect.width, rect.height, GUID_WICPixelFormat32bppPBGRA, WICBitmapCacheOnLoad,
+                                    &bitmap);
+    auto props = D2D1::RenderTargetProperties(
+        D2D1_RENDER_TARGET_TYPE_SOFTWARE, D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_PREMULTIPLIED));
+    if (SUCCEEDED(hr)) {
+        hr = d2d_->CreateWicBitmapRenderTarget(bitmap, props, &rt);
+    }
+    auto font = WidenUtf8(layer.font), wide = WidenUtf8(text);
+    if (SUCCEEDED(hr)) {
+        hr = dwrite_->CreateTextFormat(font.c_str(), nullptr, DWRITE_FONT_WEIGHT_NORMAL, DWRITE_FONT_STYLE_NORMAL,
+                                       DWRITE_FONT_STRETCH_NORMAL, layer.fontSize, L"en-us", &format);
+    }
+    if (SUCCEEDED(hr)) {
+        format->SetTextAlignment(DWRITE_TEXT_ALIGNMENT_CENTER);
+        format->SetParagraphAlignment(DWRITE_PARAGRAPH_ALIGNMENT_CENTER);
+        auto channel = [&](int shift) { return ((layer.color >> shift) & 0xFF) / 255.0f; };
+        hr = rt->CreateSolidColorBrush(D2D1::ColorF(channel(16), channel(8), channel(0), channel(24)), &brush);
+    }
+    if (FAILED(hr)) {
+        fmt::print("Could not draw the title of {}.\n", text);
+        return false;
+    }
+    rt->BeginDraw();
+    rt->Clear(D2D1::ColorF(0, 0, 0, 0));
+    rt->DrawText(wide.c_str(), (UINT32)wide.size(), format, D2D1::RectF(0, 0, (float)rect.width, (float)rect.height),
+                 brush);
+    hr = rt->EndDraw();
+
+    Image image{.width = rect.width, .height = rect.height};
+    image.pixels.resize(4 * (size_t)rect.width * rect.height);
+    if (SUCCEEDED(hr)) {
+        hr = bitmap->CopyPixels(nullptr, 4 * rect.width, (UINT)image.pixels.size(), image.pixels.data());
+    }
+    if (FAILED(hr)) {
+        return false;
+    }
+    for (size_t i = 0; i < image.pixels.size(); i += 4) {
+        std::swap(image.pixels[i], image.pixels[i + 2]); // BGRA to RGBA
+    }
+    BlendImage(image, rect, overlay);
+    return true;
+}
+
+bool CardCompositor::BuildOverlay(DivinationCardArt const &card, FrameBuffer &overlay) {
+    for (uint32_t y = 0; y < overlay.height; ++y) {
+        memset(overlay.Pixel(0, y), 0, 4 * (size_t)overlay.width);
+    }
+    bool ok = true;
+    for (auto &layer : layout_.layers) {
+        if (layer.kind == CardLayerKind::Title) {
+            ok &= DrawTitle(card.Title(), layer, overlay);
+            continue;
+        }
+        // Per-card art is used once, so only layers without {art} go into the shared cache.
+        if (auto art = layer.path.find("{art}"); art != std::string::npos) {
+            auto path = layer.path;
+            path.replace(art, 5, card.virtualFile);
+            auto image = LoadImage(path, layer.rect.width, layer.rect.height);
+            ok &= image.has_value();
+            if (image) {
+                BlendImage(*image, layer.rect, overlay);
+            }
+        } else if (auto *image = SharedImage(layer.path, layer.rect.width, layer.rect.height)) {
+            BlendImage(*image, layer.rect, overlay);
+        } else {
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+void CardCompositor::Composite(FrameBuffer const &background, FrameBuffer const &overlay, FrameBuffer &out) const {
+    auto &bg = layout_.background;
+    for (int y = 0; y < (int)out.height; ++y) {
+        memcpy(out.Pixel(0, y), overlay.Pixel(0, y), 4 * (size_t)out.width);
+        if (y < bg.y || y >= bg.y + bg.height) {
+            continue;
+        }
+        // Where the background shows, start from it and blend the overlay row segment on top.
+        memcpy(out.Pixel(bg.x, y), background.Pixel(0, y - bg.y), 4 * (size_t)bg.width);
+        BlendOver(out.Pixel(bg.x, y), overlay.Pixel(bg.x, y), bg.width);
+    }
+}
+
+size_t CardCompositor::CacheBytes() const {
+    size_t ret = 0;
+    for (auto &[key, image] : sharedImages_) {
+        ret += image ? image->pixels.capacity() : 0;
+    }
+    return ret;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "CardArt.hpp"
+#include "FramePool.hpp"
+
+#include <atlbase.h>
+#include <d2d1.h>
+#include <dwrite.h>
+#include <wincodec.h>
+
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Premultiplied source-over of a run of RGBA8 pixels, dst = src + dst * (1 - src.a), four pixels at a time.
+void BlendOver(uint8_t *dst, uint8_t const *src, size_t pixels);
+
+// Builds finished cards. The static layers of a card are rasterized once into a premultiplied overlay, which is then
+// blended over every animated background frame; images shared by all cards, like the frame, are decoded once.
+struct CardCompositor {
+    CardCompositor(CardLayout layout, std::vector<std::filesystem::path> resourceRoots);
+
+    CardLayout const &Layout() const { return layout_; }
+
+    bool BuildOverlay(DivinationCardArt const &card, FrameBuffer &overlay);
+
+    // Places the background frame at the layout's background rectangle and blends the overlay over the whole card.
+    void Composite(FrameBuffer const &background, FrameBuffer const &overlay, FrameBuffer &out) const;
+
+    size_t CacheBytes() const;
+
+    // Rasterizes text centred in the layer's rectangle and blends it into the overlay.
+    bool DrawTitle(std::string const &text, CardStaticLayer const &layer, FrameBuffer &overlay);
+
+  private:
+    struct Image {
+        int width{}, height{};
+        std::vector<uint8_t> pixels; // premultiplied RGBA8, tightly packed
+    };
+
+    std::optional<Image> LoadImage(std::string const &path, int width, int height) const;
+    Image const *SharedImage(std::string const &path, int width, int height);
+    void BlendImage(Image const &image, PixelRect rect, FrameBuffer &overlay) const;
+
+    CardLayout layout_;
+    std::vector<std::filesystem::path> resourceRoots_;
+    std::map<std::string, std::optional<Image>> sharedImages_; // by path and size, including failed loads
+
+    CComPtr<IWICImagingFactory> wic_;
+    CComPtr<ID2D1Factory> d2d_;
+    CComPtr<IDWriteFactory> dwrite_;
+};
@@ -5,70 +5,233 @@
 #include <directxtk/DDSTextureLoader.h>
 #include <fmt/format.h>
 
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <regex>
+#include <utility>
 
+// Text of every include read so far, shared by all compiles of one DivFxCompiler.
+struct IncludeCache {
+    std::mutex mutex;
+    std::map<std::string, std::string> files; // by PathKey, entries stay put while a compile holds their text
+};
+
+namespace {
+// Resolves includes against the asset root through the shared cache, noting which files one compile opened.
 struct DirectoryIncluder : ID3DInclude {
-    explicit DirectoryIncluder(std::filesystem::path root) : root(root) {}
+    DirectoryIncluder(std::filesystem::path root, IncludeCache &cache) : root(root), cache(cache) {}
 
     HRESULT __stdcall Open(D3D_INCLUDE_TYPE type, LPCSTR fileName, LPCVOID parentData, LPCVOID *outData,
                            UINT *outSize) override {
-        auto candidatePath = root / fileName;
-        if (!exists(candidatePath)) {
-            return E_FAIL;
+        auto candidatePath = (root / fileName).lexically_normal();
+        auto key = PathKey(candidatePath);
+        std::unique_lock lock(cache.mutex);
+        auto I = cache.files.find(key);
+        if (I == cache.files.end()) {
+            lock.unlock();
+            if (!exists(candidatePath)) {
+                return E_FAIL;
+            }
+            auto text = SlurpTextFile(candidatePath);
+            lock.lock();
+            I = cache.files.emplace(key, std::move(text)).first;
         }
-        auto text = SlurpTextFile(candidatePath);
-        auto cch = text.size();
-        auto buf = std::make_unique<char[]>(cch + 1);
-        memcpy(buf.get(), text.c_str(), cch + 1);
-        *outData = buf.release();
-        *outSize = cch;
+        opened.push_back(candidatePath);
+        *outData = I->second.c_str();
+        *outSize = (UINT)I->second.size();
         return S_OK;
     }
 
-    HRESULT __stdcall Close(LPCVOID data) override {
-        std::unique_ptr<char[]> _((char *)data);
-        return S_OK;
-    }
+    HRESULT __stdcall Close(LPCVOID data) override { return S_OK; }
 
     std::filesystem::path root;
+    IncludeCache &cache;
+    std::vector<std::filesystem::path> opened;
+};
+} // namespace
+
+ShaderSpecialization &ShaderSpecialization::Float(std::string field, float value) {
+    // HLSL has no literal for infinities and NaNs, and "1f" is not a float literal, so whole numbers get a ".0".
+    std::string literal;
+    if (!std::isfinite(value)) {
+        literal = fmt::format("asfloat({}u)", std::bit_cast<uint32_t>(value));
+    } else {
+        literal = fmt::format("{:.9g}", value);
+        if (literal.find_first_of(".e") == std::string::npos) {
+            literal += ".0";
+        }
+        literal += "f";
+    }
+    constants.push_back({std::move(field), fmt::format("({})", literal)});
+    return *this;
+}
+
+ShaderSpecialization &ShaderSpecialization::Uint(std::string field, uint32_t value) {
+    constants.push_back({std::move(field), fmt::format("({}u)", value)});
+    return *this;
+}
+
+ShaderSpecialization &ShaderSpecialization::Texture(std::string name, std::array<float, 4> value) {
+    textures.push_back({std::move(name), value});
+    return *this;
+}
+
+namespace {
+DWORD CompileFlags(ShaderProfile profile) {
+    switch (profile) {
+    case ShaderProfile::Debug:
+        return D3DCOMPILE_DEBUG | D3DCOMPILE_OPTIMIZATION_LEVEL0;
+    case ShaderProfile::Release:
+        return D3DCOMPILE_OPTIMIZATION_LEVEL3;
+    }
+    return 0;
+}
+
+// Offsets of the bodies of the cbuffer blocks in source, from after the opening brace to the closing one.
+std::vector<std::pair<size_t, size_t>> CbufferBodies(std::string const &source) {
+    std::vector<std::pair<size_t, size_t>> ret;
+    std::regex header(R"(\bcbuffer\s+\w+\s*(:\s*register\s*\([^)]*\)\s*)?\{)");
+    for (std::sregex_iterator I(source.begin(), source.end(), header), E; I != E; ++I) {
+        size_t begin = I->position(0) + I->length(0), end = begin;
+        for (int depth = 1; end < source.size(); ++end) {
+            depth += source[end] == '{' ? 1 : source[end] == '}' ? -1 : 0;
+            if (depth == 0) {
+                break;
+            }
+        }
+        ret.push_back({begin, end});
+    }
+    return ret;
+}
+
+// Renames the cbuffer declaration of each specialized field to a padding member of the same type and declares a
+// static const of that name and the literal value after the cbuffer. Only cbuffer bodies are searched and nothing is
+// rewritten textually, so locals and struct members of the same name keep shadowing the field as they did before.
+// Constant textures are redeclared as DivFxConstantTexture objects.
+std::string SpecializeFragment(std::string source, ShaderSpecialization const &specialization) {
+    for (auto &constant : specialization.constants) {
+        std::regex decl(fmt::format(R"(\b(\w+)\s+{}\s*;)", constant.field));
+        std::smatch m;
+        std::optional<size_t> found;
+        size_t bodyEnd{};
+        for (auto [begin, end] : CbufferBodies(source)) {
+            if (std::regex_search(source.cbegin() + begin, source.cbegin() + end, m, decl)) {
+                found = begin + m.position(0);
+                bodyEnd = end;
+                break;
+            }
+        }
+        if (!found) {
+            fmt::print("Specialization of {} skipped: no cbuffer declares it.\n", constant.field);
+            continue;
+        }
+        auto type = m[1].str();
+        auto padding = fmt::format("{} divfx_specialized_{};", type, constant.field);
+        bodyEnd += padding.size() - m.length(0);
+        source.replace(*found, m.length(0), padding);
+        // The constant goes right after the cbuffer's closing brace and its optional semicolon.
+        size_t after = source.find_first_not_of(" \t", bodyEnd + 1);
+        after = after != std::string::npos && source[after] == ';' ? after + 1 : bodyEnd + 1;
+        source.insert(after, fmt::format("\nstatic const {} {} = {};", type, constant.field, constant.literal));
+    }
+
+    bool foldedTexture = false;
+    for (auto &texture : specialization.textures) {
+        std::regex decl(fmt::format(R"((TEXTURE2D_DECL\s*\(\s*{0}\s*\)|\bTexture2D\s*(<[^>]*>)?\s+{0}\b))"
+                                    R"((\s*:\s*register\s*\([^)]*\))?)",
+                                    texture.name));
+        std::smatch m;
+        if (!std::regex_search(source, m, decl)) {
+            fmt::print("Folding of {} skipped: declaration not found.\n", texture.name);
+            continue;
+        }
+        auto &v = texture.value;
+        auto replacement = fmt::format("static DivFxConstantTexture {} = {{float4({:.9g}, {:.9g}, {:.9g}, {:.9g})}}",
+                                       texture.name, v[0], v[1], v[2], v[3]);
+        source.replace(m.position(0), m.length(0), replacement);
+        foldedTexture = true;
+    }
+    if (foldedTexture) {
+        source = R"(struct DivFxConstantTexture {
+    float4 value;
+    float4 Sample(SamplerState s, float2 uv) { return value; }
+    float4 Sample(SamplerState s, float2 uv, int2 offset) { return value; }
+    float4 SampleBias(SamplerState s, float2 uv, float bias) { return value; }
+    float4 SampleLevel(SamplerState s, float2 uv, float lod) { return value; }
+    float4 SampleLevel(SamplerState s, float2 uv, float lod, int2 offset) { return value; }
+    float4 SampleGrad(SamplerState s, float2 uv, float2 ddx, float2 ddy) { return value; }
+    float4 Load(int3 location) { return value; }
+    void GetDimensions(out uint width, out uint height) { width = 1; height = 1; }
 };
+)" + source;
+    }
+    return source;
+}
+} // namespace
 
-DivFxCompiler::DivFxCompiler(std::filesystem::path assetRoot, std::string prelude)
-    : assetRoot_(assetRoot), prelude_(prelude), includer_(std::make_shared<DirectoryIncluder>(assetRoot)) {
-    if (prelude_.back() != '\n') {
-        prelude += "\n";
+DivFxCompiler::DivFxCompiler(std::filesystem::path assetRoot, std::string prelude, ShaderProfile profile)
+    : assetRoot_(assetRoot), prelude_(prelude), profile_(profile), includes_(std::make_shared<IncludeCache>()) {
+    if (!prelude_.empty() && prelude_.back() != '\n') {
+        prelude_ += "\n";
     }
-    std::string draw2dFragment = SlurpTextFile(assetRoot / "Shaders/Draw2D.hlsl");
+}
+
+bool DivFxCompiler::CompileVertexShader() {
+    auto draw2dPath = (assetRoot_ / "Shaders/Draw2D.hlsl").lexically_normal();
+    std::string draw2dFragment = SlurpTextFile(draw2dPath);
     std::string vsSource = prelude_ + draw2dFragment;
 
-    CComPtr<ID3DBlob> errors;
+    CComPtr<ID3DBlob> bytecode, errors;
 
     HRESULT hr{S_OK};
-    DWORD flags = 0;
-    flags |= D3DCOMPILE_DEBUG | D3DCOMPILE_OPTIMIZATION_LEVEL0;
-    hr = D3DCompile(std::data(vsSource), std::size(vsSource), nullptr, nullptr, includer_.get(), "VShad", "vs_5_0",
-                    flags, 0, &vsBytecode_, &errors);
+    DWORD flags = CompileFlags(profile_);
+    DirectoryIncluder includer(assetRoot_, *includes_);
+    hr = D3DCompile(std::data(vsSource), std::size(vsSource), nullptr, nullptr, &includer, "VShad", "vs_5_0", flags,
+                    0, &bytecode, &errors);
+    vsDependencies_ = std::move(includer.opened);
+    vsDependencies_.push_back(draw2dPath);
     if (SUCCEEDED(hr)) {
         fmt::print("Shader compilation success.\n");
-    } else {
-        fmt::print("Shader compilation failure: {}", hr);
-        std::string msgs((char const *)errors->GetBufferPointer(), errors->GetBufferSize());
-        fmt::print("===\n{}===\n", msgs);
+        vsBytecode_ = bytecode;
+        return true;
     }
+    fmt::print("Shader compilation failure: {}", hr);
+    std::string msgs((char const *)errors->GetBufferPointer(), errors->GetBufferSize());
+    fmt::print("===\n{}===\n", msgs);
+    return false;
 }
 
-DivFx DivFxCompiler::Compile(std::string psFragment, std::string psEntrypoint) {
+DivFx DivFxCompiler::Compile(std::string psFragment, std::string psEntrypoint,
+                             ShaderSpecialization const &specialization) const {
     DivFx ret;
     HRESULT hr{S_OK};
     CComPtr<ID3DBlob> errors;
 
-    std::string psSource = prelude_ + psFragment;
+    std::string psSource = prelude_ + SpecializeFragment(psFragment, specialization);
 
     errors = {};
-    DWORD flags = 0;
-    flags |= D3DCOMPILE_DEBUG | D3DCOMPILE_OPTIMIZATION_LEVEL0;
-    hr = D3DCompile(std::data(psSource), std::size(psSource), nullptr, nullptr, includer_.get(), psEntrypoint.c_str(),
+    DWORD flags = CompileFlags(profile_);
+    DirectoryIncluder includer(assetRoot_, *includes_);
+    hr = D3DCompile(std::data(psSource), std::size(psSource), nullptr, nullptr, &includer, psEntrypoint.c_str(),
                     "ps_5_0", flags, 0, &ret.psBytecode, &errors);
+    if (FAILED(hr) && !specialization.Empty()) {
+        // A folded texture passed to a function taking a Texture2D, for instance, does not survive specialization.
+        std::string msgs = errors ? std::string((char const *)errors->GetBufferPointer(), errors->GetBufferSize()) : "";
+        fmt::print("Specialized compilation of {} failed: {}\n===\n{}===\nCompiling it unspecialized.\n", psEntrypoint,
+                   hr, msgs);
+        ret.unspecialized = true;
+        psSource = prelude_ + psFragment;
+        errors = {};
+        includer.opened.clear();
+        hr = D3DCompile(std::data(psSource), std::size(psSource), nullptr, nullptr, &includer, psEntrypoint.c_str(),
+                        "ps_5_0", flags, 0, &ret.psBytecode, &errors);
+    }
+    ret.includes = std::move(includer.opened);
     if (SUCCEEDED(hr)) {
         fmt::print("Shader compilation success.\n");
     } else {
@@ -82,36 +245,128 @@ DivFx DivFxCompiler::Compile(std::string psFragment, std::string psEntrypoint) {
 
 CComPtr<ID3DBlob> DivFxCompiler::VSBytecode() const { return vsBytecode_; }
 
-Dx::LoadTextureResult Dx::LoadTexture(std::filesystem::path const &path, bool viewAsSrgb) {
-    if (auto I = textures.find(path); I != textures.end()) {
-        return I->second;
+std::vector<std::filesystem::path> const &DivFxCompiler::VSDependencies() const { return vsDependencies_; }
+
+void DivFxCompiler::InvalidateInclude(std::filesystem::path const &path) {
+    std::lock_guard lock(includes_->mutex);
+    includes_->files.erase(PathKey(path));
+}
+
+bool Dx::CreateOffscreenDevice(UINT flags) {
+    D3D_FEATURE_LEVEL featureLevels[] = {D3D_FEATURE_LEVEL_11_0};
+    HRESULT hr = D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_HARDWARE, nullptr, flags, std::data(featureLevels),
+                                   std::size(featureLevels), D3D11_SDK_VERSION, &dev, &featureLevel, &ctx);
+    if (FAILED(hr)) {
+        fmt::print("Device creation failure: {}\n", hr);
+        return false;
     }
+    BuildSamplers();
+    return true;
+}
+
+Dx::LoadTextureResult Dx::LoadTexture(std::filesystem::path const &path, bool viewAsSrgb, TextureFootprint footprint) {
+    std::unique_lock lock(deviceMutex);
+    if (auto I = textures.find({path, viewAsSrgb}); I != textures.end()) {
+        if (I->second.footprint.Covers(footprint)) {
+            return I->second;
+        }
+        footprint = I->second.footprint.Union(footprint);
+    }
+    lock.unlock();
     CComPtr<ID3D11Resource> resource;
     CComPtr<ID3D11ShaderResourceView> srv;
     for (auto &root : resourceRoots_) {
         auto finalPath = root / path;
         if (exists(finalPath)) {
+            // The file read runs unlocked so loads overlap; creation may generate mips on the immediate context.
+            auto file = ReadDdsFile(finalPath, [&](uint64_t width, uint64_t height, uint32_t mips) {
+                return footprint.FinestMip(width, height, mips);
+            });
+            if (!file) {
+                continue;
+            }
             DirectX::DDS_LOADER_FLAGS loadFlags =
                 viewAsSrgb ? DirectX::DDS_LOADER_FORCE_SRGB : DirectX::DDS_LOADER_DEFAULT;
-            HRESULT hr = DirectX::CreateDDSTextureFromFileEx(dev, ctx, finalPath.generic_wstring().c_str(), 0,
-                                                             D3D11_USAGE_DEFAULT, D3D11_BIND_SHADER_RESOURCE, 0, 0,
-                                                             loadFlags, &resource, &srv);
+            lock.lock();
+            auto I = textures.find({path, viewAsSrgb});
+            if (I != textures.end() && I->second.footprint.Covers(footprint)) {
+                return I->second;
+            }
+            HRESULT hr = DirectX::CreateDDSTextureFromMemoryEx(dev, ctx, file->data.data(), file->data.size(), 0,
+                                                               D3D11_USAGE_DEFAULT, D3D11_BIND_SHADER_RESOURCE, 0, 0,
+                                                               loadFlags, &resource, &srv);
             if (SUCCEEDED(hr)) {
-                textures[path] = {resource, srv};
-                break;
+                LoadTextureResult ret{resource, srv, footprint, file->skippedMips};
+                textures[{path, viewAsSrgb}] = ret;
+                return ret;
             }
+            lock.unlock();
         }
     }
     return {resource, srv};
 }
 
+Dx::LoadTextureResult Dx::SolidTexture(UINT width, UINT height, uint32_t color) {
+    std::lock_guard lock(deviceMutex);
+    auto key = std::make_tuple(width, height, color);
+    if (auto I = solidTextures.find(key); I != solidTextures.end()) {
+        return I->second;
+    }
+
+    auto *data = uploadArena.Allocate<uint32_t>(width * height);
+    std::fill_n(data, width * height, color);
+    UINT pitch = 4 * width;
+    UINT slicePitch = pitch * height;
+
+    CComPtr<ID3D11Texture2D> tex;
+    D3D11_TEXTURE2D_DESC td{.Width = width,
+                            .Height = height,
+                            .MipLevels = 0,
+                            .ArraySize = 1,
+                            .Format = DXGI_FORMAT_B8G8R8A8_UNORM,
+                            .SampleDesc = {1, 0},
+                            .Usage = D3D11_USAGE_DEFAULT,
+                            .BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE,
+                            .MiscFlags = 0};
+    // Every mip level is the same solid color, so all of them can source from the top level's data.
+    D3D11_SUBRESOURCE_DATA srds[D3D11_REQ_MIP_LEVELS]{};
+    for (auto &srd : srds) {
+        srd = D3D11_SUBRESOURCE_DATA{.pSysMem = data, .SysMemPitch = pitch, .SysMemSlicePitch = slicePitch};
+    }
+    dev->CreateTexture2D(&td, srds, &tex);
+    uploadArena.Reset();
+
+    CComPtr<ID3D11ShaderResourceView> srv;
+    dev->CreateShaderResourceView(tex, nullptr, &srv);
+
+    LoadTextureResult ret{tex, srv};
+    solidTextures[key] = ret;
+    return ret;
+}
+
+void Dx::ReportMemory(MemoryReport &report) const {
+    for (auto &[key, tex] : textures) {
+        auto &[path, srgb] = key;
+        report.Add("texture",
+                   fmt::format("{}{}{}", path.string(), srgb ? " (sRGB)" : "",
+                               tex.skippedMips ? fmt::format(" from mip {}", tex.skippedMips) : ""),
+                   ResourceBytes(tex.resource));
+    }
+    for (auto &[key, tex] : solidTextures) {
+        auto &[width, height, color] = key;
+        report.Add("texture", fmt::format("solid {}x{} {:08X}", width, height, color), ResourceBytes(tex.resource));
+    }
+    auto &arena = uploadArena.Stats();
+    report.Add("arena", "texture upload", arena.bytesReserved, arena.peakBytesInUse);
+}
+
 void Dx::AddResourceRoot(std::filesystem::path const &path) {
     if (std::find(resourceRoots_.begin(), resourceRoots_.end(), path) == resourceRoots_.end()) {
         resourceRoots_.push_back(path);
     }
 }
 
-void Dx::BuildSamplers() {
+void Dx::BuildSamplers(SamplerQuality quality) {
     struct SamplerSpec {
         std::string_view name;
         D3D11_FILTER filter;
@@ -237,6 +492,14 @@ void Dx::BuildSamplers() {
     samplerStorage.clear();
     samplerNames.clear();
     for (auto &spec : specs) {
+        if (quality == SamplerQuality::Draft) {
+            if (spec.filter == D3D11_FILTER_MIN_MAG_MIP_LINEAR) {
+                spec.filter = D3D11_FILTER_MIN_MAG_LINEAR_MIP_POINT;
+            } else if (spec.filter == D3D11_FILTER_COMPARISON_MIN_MAG_MIP_LINEAR) {
+                spec.filter = D3D11_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT;
+            }
+            spec.lodBias = (std::max)(spec.lodBias.value_or(0.0f), 0.0f);
+        }
         D3D11_SAMPLER_DESC sd{
             .Filter = spec.filter,
             .AddressU = spec.addressU,
@@ -6,9 +6,21 @@
 #include <atlbase.h>
 #include <atlcom.h>
 
+#include "Dds.hpp"
+#include "FramePool.hpp"
+#include "MemoryStats.hpp"
+
+#include <array>
 #include <filesystem>
+#include <map>
+#include <mutex>
 #include <string>
-#include <unordered_map>
+#include <tuple>
+
+enum class SamplerQuality {
+    Full,  // trilinear with a slight sharpening bias
+    Draft, // bilinear from the nearest mip without the bias, for quick previews
+};
 
 struct Dx {
     CComPtr<ID3D11Device> dev;
@@ -23,36 +35,100 @@ struct Dx {
     struct LoadTextureResult {
         CComPtr<ID3D11Resource> resource;
         CComPtr<ID3D11ShaderResourceView> srv;
+        TextureFootprint footprint; // what a loaded texture's mips were trimmed for
+        uint32_t skippedMips{};
     };
 
-    std::unordered_map<std::filesystem::path, LoadTextureResult> textures;
+    // Loaded and generated textures, shared by every layer that binds them.
+    std::map<std::pair<std::filesystem::path, bool>, LoadTextureResult> textures;
+    std::map<std::tuple<UINT, UINT, uint32_t>, LoadTextureResult> solidTextures;
     std::vector<std::filesystem::path> resourceRoots_;
 
-    LoadTextureResult LoadTexture(std::filesystem::path const &path, bool viewAsSrgb = false);
+    // Transient staging memory for texture uploads, reset after each upload.
+    FrameArena uploadArena;
+
+    // Guards the texture caches, the upload arena and texture creation on the immediate context, which is not
+    // thread-safe, so layers can load textures from several threads.
+    std::mutex deviceMutex;
+
+    // Creates a device without a window or swap chain, for rendering straight to textures, and its samplers.
+    bool CreateOffscreenDevice(UINT flags = 0);
+
+    // Loads a DDS file without the mips the footprint can never sample. A cached texture trimmed for a smaller
+    // footprint is reloaded for the union of both; layers holding the old one keep it until they rebind.
+    LoadTextureResult LoadTexture(std::filesystem::path const &path, bool viewAsSrgb = false,
+                                  TextureFootprint footprint = {});
+    // Full mip chain of a single B8G8R8A8 color.
+    LoadTextureResult SolidTexture(UINT width, UINT height, uint32_t color);
 
     void AddResourceRoot(std::filesystem::path const &path);
 
-    void BuildSamplers();
+    // Rebuilds the sampler table; layers pick up the new samplers on their next draw.
+    void BuildSamplers(SamplerQuality quality = SamplerQuality::Full);
+
+    void ReportMemory(MemoryReport &report) const;
 };
 
 struct DivFx {
     CComPtr<ID3DBlob> vsBytecode, psBytecode;
+    std::vector<std::filesystem::path> includes; // every file the compile pulled in through #include
+    bool unspecialized{}; // the specialized compile failed and this is the unspecialized fallback
 };
 
-struct DirectoryIncluder;
+struct IncludeCache;
+
+enum class ShaderProfile {
+    Debug,   // unoptimized with debug info, for graphics debuggers
+    Release, // fully optimized
+};
+
+// Constant-valued cbuffer fields baked into a shader variant. Each field keeps its slot in the cbuffer layout but every
+// use after the cbuffer sees the literal, letting the compiler fold the branches and fetches it controls.
+struct ShaderSpecialization {
+    struct Constant {
+        std::string field;
+        std::string literal;
+    };
+    std::vector<Constant> constants;
+
+    // Textures known to sample as one value everywhere, such as solid or unbound ones. The texture declaration is
+    // replaced by an object with the same sampling methods returning the value, so the fetches fold away.
+    struct ConstantTexture {
+        std::string name;
+        std::array<float, 4> value;
+    };
+    std::vector<ConstantTexture> textures;
+
+    ShaderSpecialization &Float(std::string field, float value);
+    ShaderSpecialization &Uint(std::string field, uint32_t value);
+    ShaderSpecialization &Texture(std::string name, std::array<float, 4> value);
+
+    bool Empty() const { return constants.empty() && textures.empty(); }
+};
 
 struct DivFxCompiler {
-    DivFxCompiler(std::filesystem::path assetRoot, std::string prelude);
+    DivFxCompiler(std::filesystem::path assetRoot, std::string prelude, ShaderProfile profile = ShaderProfile::Release);
 
-    DivFx Compile(std::string psFragment, std::string psEntrypoint);
+    // Compiles the shared vertex shader, keeping the previous bytecode if it fails; pixel shader compiles may run
+    // concurrently from several threads.
+    bool CompileVertexShader();
+    DivFx Compile(std::string psFragment, std::string psEntrypoint,
+                  ShaderSpecialization const &specialization = {}) const;
 
     CComPtr<ID3DBlob> VSBytecode() const;
+    // Files the vertex shader was built from besides the prelude.
+    std::vector<std::filesystem::path> const &VSDependencies() const;
+
+    // Drops a changed include from the in-memory include cache so the next compile reads it again.
+    void InvalidateInclude(std::filesystem::path const &path);
 
   private:
     std::filesystem::path assetRoot_;
     std::string prelude_;
+    ShaderProfile profile_;
     CComPtr<ID3DBlob> vsBytecode_;
-    std::shared_ptr<DirectoryIncluder> includer_;
+    std::vector<std::filesystem::path> vsDependencies_;
+    std::shared_ptr<IncludeCache> includes_;
 };
 
 CComPtr<ID3D11ShaderResourceView> LoadDDS(Dx &dx, std::filesystem::path const &path);
\ No newline at end of file
@@ -0,0 +1,110 @@
+#include "Dds.hpp"
+
+#include <DirectXTex.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+uint32_t TextureFootprint::FinestMip(uint64_t texWidth, uint64_t texHeight, uint32_t mipLevels) const {
+    if (width <= 0 || height <= 0 || mipLevels <= 1) {
+        return 0;
+    }
+    double texelsPerPixel = (std::max)((double)texWidth / width, (double)texHeight / height) * minUvScale;
+    // One level of margin for UVs the shader distorts, such as the muddle offsets, which locally magnify the texture.
+    double lod = std::log2((std::max)(texelsPerPixel, 1e-6)) + lodBias - 1.0;
+    if (lod <= 0.0) {
+        return 0;
+    }
+    return (std::min)((uint32_t)lod, mipLevels - 1);
+}
+
+bool TextureFootprint::Covers(TextureFootprint const &other) const {
+    if (width <= 0 || height <= 0) {
+        return true;
+    }
+    if (other.width <= 0 || other.height <= 0) {
+        return false;
+    }
+    return width >= other.width && height >= other.height && minUvScale <= other.minUvScale &&
+           lodBias <= other.lodBias;
+}
+
+TextureFootprint TextureFootprint::Union(TextureFootprint const &other) const {
+    if (width <= 0 || height <= 0 || other.width <= 0 || other.height <= 0) {
+        return {};
+    }
+    return {
+        .width = (std::max)(width, other.width),
+        .height = (std::max)(height, other.height),
+        .minUvScale = (std::min)(minUvScale, other.minUvScale),
+        .lodBias = (std::min)(lodBias, other.lodBias),
+    };
+}
+
+std::optional<DdsFile> ReadDdsFile(std::filesystem::path const &path,
+                                   std::function<uint32_t(uint64_t width, uint64_t height, uint32_t mips)> firstMip) {
+    std::error_code ec;
+    auto fileSize = (size_t)file_size(path, ec);
+    std::ifstream is(path, std::ios::binary);
+    if (ec || !is) {
+        return std::nullopt;
+    }
+
+    // Magic and DDS_HEADER, then DDS_HEADER_DXT10 when the pixel format's FourCC is DX10.
+    enum { eBaseHeaderSize = 128, eDx10HeaderSize = 20, eHeightOffset = 12, eWidthOffset = 16, eMipCountOffset = 28 };
+    enum { eFourCcOffset = 84 };
+    std::vector<uint8_t> header(eBaseHeaderSize + eDx10HeaderSize);
+    is.read((char *)header.data(), header.size());
+    size_t headerRead = (size_t)is.gcount();
+    size_t headerSize = eBaseHeaderSize;
+    if (headerRead >= eBaseHeaderSize && memcmp(&header[eFourCcOffset], "DX10", 4) == 0) {
+        headerSize += eDx10HeaderSize;
+    }
+
+    DirectX::TexMetadata meta{};
+    bool trimmable =
+        headerRead >= headerSize &&
+        SUCCEEDED(DirectX::GetMetadataFromDDSMemory(header.data(), headerSize, DirectX::DDS_FLAGS_NONE, meta)) &&
+        meta.dimension == DirectX::TEX_DIMENSION_TEXTURE2D && meta.arraySize == 1 && meta.depth == 1 &&
+        !meta.IsCubemap() && meta.mipLevels > 1;
+    std::vector<size_t> mipBytes;
+    size_t totalBytes = 0;
+    for (size_t level = 0; trimmable && level < meta.mipLevels; ++level) {
+        size_t rowPitch{}, slicePitch{};
+        trimmable = SUCCEEDED(DirectX::ComputePitch(meta.format, (std::max)(meta.width >> level, size_t{1}),
+                                                    (std::max)(meta.height >> level, size_t{1}), rowPitch,
+                                                    slicePitch));
+        mipBytes.push_back(slicePitch);
+        totalBytes += slicePitch;
+    }
+    // Formats expanded on load, like 24-bit RGB, are stored smaller than their metadata says; those load whole.
+    trimmable = trimmable && headerSize + totalBytes == fileSize;
+
+    uint32_t skip = trimmable ? (std::min)(firstMip(meta.width, meta.height, (uint32_t)meta.mipLevels),
+                                           (uint32_t)meta.mipLevels - 1)
+                              : 0;
+    DdsFile ret{.skippedMips = skip};
+    if (skip == 0) {
+        ret.data.resize(fileSize);
+        is.clear();
+        is.seekg(0);
+        is.read((char *)ret.data.data(), ret.data.size());
+        return is ? std::optional(std::move(ret)) : std::nullopt;
+    }
+
+    size_t skipBytes = 0;
+    for (uint32_t level = 0; level < skip; ++level) {
+        skipBytes += mipBytes[level];
+    }
+    ret.data.resize(fileSize - skipBytes);
+    memcpy(ret.data.data(), header.data(), headerSize);
+    auto patch = [&](size_t offset, uint32_t value) { memcpy(ret.data.data() + offset, &value, sizeof(value)); };
+    patch(eHeightOffset, (uint32_t)(std::max)(meta.height >> skip, size_t{1}));
+    patch(eWidthOffset, (uint32_t)(std::max)(meta.width >> skip, size_t{1}));
+    patch(eMipCountOffset, (uint32_t)meta.mipLevels - skip);
+    is.seekg(headerSize + skipBytes);
+    is.read((char *)ret.data.data() + headerSize, ret.data.size() - headerSize);
+    return is ? std::optional(std::move(ret)) : std::nullopt;
+}
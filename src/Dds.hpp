@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <vector>
+
+// How a texture binding is drawn, for working out the finest mip its sampler can reach. The texture's 0..1 UV range
+// spans width x height output pixels at UV scale 1; the layer scales UVs by at least minUvScale, and a scale below 1
+// magnifies the texture and reaches finer mips.
+struct TextureFootprint {
+    int width{}, height{}; // 0 when unknown, which keeps every mip
+    float minUvScale = 1.0f;
+    float lodBias = -0.5f; // the full-quality samplers' bias
+
+    // First mip level sampled on a texture of the given size: the level at which one texel covers a pixel, less the
+    // sampler bias and a level of margin, floored because trilinear filtering also blends in the next finer level.
+    uint32_t FinestMip(uint64_t texWidth, uint64_t texHeight, uint32_t mipLevels) const;
+
+    // Whether a texture loaded for this footprint has every mip the other one can reach.
+    bool Covers(TextureFootprint const &other) const;
+    // Footprint reaching every mip either one does.
+    TextureFootprint Union(TextureFootprint const &other) const;
+};
+
+// DDS file contents starting at a chosen mip. The header is rewritten to describe the remaining chain and the finer
+// levels are never read from disk. firstMip is given the top size and mip count and returns the first level to keep.
+// Arrays, cube maps, volumes and legacy formats that are expanded on load are always read whole.
+struct DdsFile {
+    std::vector<uint8_t> data;
+    uint32_t skippedMips{};
+};
+
+std::optional<DdsFile> ReadDdsFile(std::filesystem::path const &path,
+                                   std::function<uint32_t(uint64_t width, uint64_t height, uint32_t mips)> firstMip);
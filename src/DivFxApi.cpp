@@ -0,0 +1,170 @@
+#include "DivFxApi.h"
+
+#include "CardLayers.hpp"
+#include "Cards.hpp"
+#include "D3D.hpp"
+#include "LayerDesc.hpp"
+#include "LoopRenderer.hpp"
+
+#include <fmt/format.h>
+#include <fmt/ranges.h>
+
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+struct divfx_context {
+    Dx dx;
+    LayerCatalog catalog; // layers refer to their descriptions in here
+    std::unique_ptr<CardLayers> layers;
+    std::unique_ptr<LoopRenderer> renderer;
+    std::vector<std::string> comboNames;
+    std::vector<std::shared_ptr<CardLayer>> selected;
+    std::mutex mutex; // the immediate context and the render target serve one render at a time
+};
+
+namespace {
+thread_local std::string lastError;
+
+divfx_status Fail(divfx_status status, std::string message) {
+    lastError = std::move(message);
+    return status;
+}
+
+std::filesystem::path Utf8Path(char const *path) { return std::u8string((char8_t const *)path); }
+
+// Bytes a frame covers in the caller's buffer; the last row needs no padding.
+size_t FrameExtent(LoopRenderer const &renderer, size_t rowPitch) {
+    auto size = renderer.Size();
+    return rowPitch * (size.y - 1) + 4 * (size_t)size.x;
+}
+} // namespace
+
+divfx_status divfx_open(char const *asset_root, char const *prelude_root, char const *layers_path,
+                        divfx_context **out) {
+    lastError.clear();
+    if (!asset_root || !prelude_root || !out) {
+        return Fail(DIVFX_INVALID_ARGUMENT, "asset_root, prelude_root and out are required");
+    }
+    *out = nullptr;
+    auto assetRoot = Utf8Path(asset_root), preludeRoot = Utf8Path(prelude_root);
+    auto preludePath = preludeRoot / "dx11_prelude.inc";
+    auto layersPath = layers_path ? Utf8Path(layers_path) : preludeRoot / "layers.txt";
+    if (!exists(preludePath)) {
+        return Fail(DIVFX_LOAD_FAILED, fmt::format("prelude {} not found", preludePath.string()));
+    }
+    auto catalog = LoadLayerCatalog(layersPath);
+    if (!catalog) {
+        return Fail(DIVFX_LOAD_FAILED, fmt::format("could not load the layer catalog {}", layersPath.string()));
+    }
+
+    auto ctx = std::make_unique<divfx_context>();
+    ctx->catalog = std::move(*catalog);
+    if (!ctx->dx.CreateOffscreenDevice()) {
+        return Fail(DIVFX_DEVICE_FAILED, "could not create a D3D11 device");
+    }
+    ctx->dx.AddResourceRoot(assetRoot);
+    ctx->dx.AddResourceRoot(preludeRoot);
+    ctx->layers = std::make_unique<CardLayers>(ctx->dx, preludePath, assetRoot, ctx->catalog, ShaderProfile::Release);
+    if (auto failed = ctx->layers->LayersWithoutShaders(); !failed.empty()) {
+        return Fail(DIVFX_COMPILE_FAILED,
+                    fmt::format("{} layers failed to compile: {}", failed.size(), fmt::join(failed, ", ")));
+    }
+    ctx->renderer = std::make_unique<LoopRenderer>(ctx->dx, glm::ivec2{eCardWidth, eCardHeight});
+    for (auto &spec : ctx->layers->combos_) {
+        ctx->comboNames.push_back(ComboName(spec));
+    }
+    *out = ctx.release();
+    return DIVFX_OK;
+}
+
+void divfx_close(divfx_context *ctx) { delete ctx; }
+
+char const *divfx_last_error(void) { return lastError.c_str(); }
+
+int32_t divfx_combo_count(divfx_context const *ctx) { return ctx ? (int32_t)ctx->comboNames.size() : 0; }
+
+char const *divfx_combo_name(divfx_context const *ctx, int32_t combo) {
+    if (!ctx || combo < 0 || combo >= (int32_t)ctx->comboNames.size()) {
+        return nullptr;
+    }
+    return ctx->comboNames[combo].c_str();
+}
+
+divfx_status divfx_select_combo(divfx_context *ctx, int32_t combo) {
+    lastError.clear();
+    if (!ctx || combo < 0 || combo >= (int32_t)ctx->comboNames.size()) {
+        return Fail(DIVFX_INVALID_ARGUMENT, fmt::format("combo {} out of range", combo));
+    }
+    std::lock_guard lock(ctx->mutex);
+    ctx->selected = ctx->renderer->ComboLayers(*ctx->layers, ctx->layers->combos_[combo]);
+    return DIVFX_OK;
+}
+
+divfx_status divfx_get_frame_info(divfx_context const *ctx, divfx_frame_info *info) {
+    lastError.clear();
+    if (!ctx || !info) {
+        return Fail(DIVFX_INVALID_ARGUMENT, "ctx and info are required");
+    }
+    auto size = ctx->renderer->Size();
+    auto &timing = ctx->renderer->Timing();
+    *info = divfx_frame_info{
+        .width = (uint32_t)size.x,
+        .height = (uint32_t)size.y,
+        .min_row_pitch = 4 * (uint32_t)size.x,
+        .frame_count = timing.numFrames,
+        .fps = timing.fps,
+    };
+    return DIVFX_OK;
+}
+
+divfx_status divfx_render_frame(divfx_context *ctx, int32_t frame, void *pixels, size_t row_pitch,
+                                size_t buffer_size) {
+    return divfx_render_frames(ctx, frame, 1, pixels, row_pitch, 0, buffer_size);
+}
+
+divfx_status divfx_render_frames(divfx_context *ctx, int32_t first, int32_t count, void *pixels, size_t row_pitch,
+                                 size_t frame_pitch, size_t buffer_size) {
+    lastError.clear();
+    if (!ctx || !pixels || count < 0) {
+        return Fail(DIVFX_INVALID_ARGUMENT, "ctx and pixels are required");
+    }
+    auto &renderer = *ctx->renderer;
+    auto size = renderer.Size();
+    int32_t numFrames = renderer.Timing().numFrames;
+    if (first < 0 || first > numFrames - count) {
+        return Fail(DIVFX_INVALID_ARGUMENT,
+                    fmt::format("frames {}..{} outside the loop of {}", first, first + count - 1, numFrames));
+    }
+    if (count == 0) {
+        return DIVFX_OK;
+    }
+    size_t extent = FrameExtent(renderer, row_pitch);
+    if (row_pitch < 4 * (size_t)size.x || (count > 1 && frame_pitch < extent) ||
+        buffer_size < frame_pitch * (count - 1) + extent) {
+        auto message = fmt::format("{} frames of {}x{} do not fit {} bytes at row pitch {} and frame pitch {}", count,
+                                   size.x, size.y, buffer_size, row_pitch, frame_pitch);
+        return Fail(DIVFX_BUFFER_TOO_SMALL, message);
+    }
+
+    std::lock_guard lock(ctx->mutex);
+    if (ctx->selected.empty()) {
+        return Fail(DIVFX_NO_COMBO, "no combo selected");
+    }
+    renderer.BindViewport();
+    for (int32_t i = 0; i < count; ++i) {
+        FrameBuffer frame{
+            .width = (uint32_t)size.x,
+            .height = (uint32_t)size.y,
+            .rowPitch = row_pitch,
+            .pixels = (uint8_t *)pixels + i * frame_pitch,
+        };
+        if (!renderer.RenderFrame(ctx->selected, first + i, frame)) {
+            return Fail(DIVFX_DEVICE_FAILED, fmt::format("readback of frame {} failed", first + i));
+        }
+    }
+    return DIVFX_OK;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+/* C interface for rendering loop frames in-process, into memory owned by the caller.
+ *
+ * A context owns its own device and renders one frame at a time; calls on one context are serialized, separate
+ * contexts can render concurrently. Frames are 8-bit RGBA in sRGB, rows top to bottom. Rows are written straight from
+ * the readback texture into the caller's buffer, so any row pitch of at least 4 * width works, including pitches that
+ * pad rows for the caller's own layout. Paths are UTF-8. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+#ifdef DIVFX_API_EXPORTS
+#define DIVFX_API __declspec(dllexport)
+#else
+#define DIVFX_API __declspec(dllimport)
+#endif
+#else
+#define DIVFX_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct divfx_context divfx_context;
+
+typedef enum divfx_status {
+    DIVFX_OK = 0,
+    DIVFX_INVALID_ARGUMENT = 1, /* null pointer, or a combo or frame index out of range */
+    DIVFX_BUFFER_TOO_SMALL = 2, /* the row pitch or buffer size cannot hold the requested frames */
+    DIVFX_LOAD_FAILED = 3,      /* the layer catalog or the prelude could not be read */
+    DIVFX_DEVICE_FAILED = 4,    /* no D3D11 device, or a readback failed */
+    DIVFX_NO_COMBO = 5,         /* nothing selected with divfx_select_combo yet */
+    DIVFX_COMPILE_FAILED = 6,   /* a layer's pixel shader did not compile */
+} divfx_status;
+
+typedef struct divfx_frame_info {
+    uint32_t width, height;
+    uint32_t min_row_pitch; /* 4 * width */
+    int32_t frame_count;    /* frames in one loop, frame indices run from 0 to frame_count - 1 */
+    float fps;
+} divfx_frame_info;
+
+/* Compiles every layer of a catalog. layers_path may be null for layers.txt in the prelude root. Fails with
+   DIVFX_COMPILE_FAILED, naming the layers in divfx_last_error, if any layer's shader does not compile. */
+DIVFX_API divfx_status divfx_open(char const *asset_root, char const *prelude_root, char const *layers_path,
+                                  divfx_context **out);
+DIVFX_API void divfx_close(divfx_context *ctx);
+
+/* Message for the last failed call on this thread, empty if there was none. */
+DIVFX_API char const *divfx_last_error(void);
+
+DIVFX_API int32_t divfx_combo_count(divfx_context const *ctx);
+/* Name the command line exports the combo under, such as "div_bg_0_3"; null when out of range. */
+DIVFX_API char const *divfx_combo_name(divfx_context const *ctx, int32_t combo);
+DIVFX_API divfx_status divfx_select_combo(divfx_context *ctx, int32_t combo);
+
+DIVFX_API divfx_status divfx_get_frame_info(divfx_context const *ctx, divfx_frame_info *info);
+
+/* Renders one frame of the selected combo into pixels, which holds height rows of row_pitch bytes. */
+DIVFX_API divfx_status divfx_render_frame(divfx_context *ctx, int32_t frame, void *pixels, size_t row_pitch,
+                                          size_t buffer_size);
+
+/* Renders frames first to first + count - 1 into consecutive slots frame_pitch bytes apart. */
+DIVFX_API divfx_status divfx_render_frames(divfx_context *ctx, int32_t first, int32_t count, void *pixels,
+                                           size_t row_pitch, size_t frame_pitch, size_t buffer_size);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,7 +1,25 @@
 #define GLFW_EXPOSE_NATIVE_WIN32
 
+#include "CardArt.hpp"
+#include "CardLayers.hpp"
 #include "Cards.hpp"
+#include "Checkpoint.hpp"
+#include "Compositor.hpp"
 #include "D3D.hpp"
+#include "Draft.hpp"
+#include "FileWatcher.hpp"
+#include "FramePool.hpp"
+#include "FrameRing.hpp"
+#include "ImageCodec.hpp"
+#include "LayerDesc.hpp"
+#include "Loop.hpp"
+#include "LoopRenderer.hpp"
+#include "MemoryStats.hpp"
+#include "Packing.hpp"
+#include "RegionSplit.hpp"
+#include "Shards.hpp"
+#include "Stress.hpp"
+#include "Sweep.hpp"
 #include "Util.hpp"
 
 #include <DirectXTex.h>
@@ -11,70 +29,25 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <filesystem>
 #include <fstream>
-#include <functional>
 #include <iostream>
 #include <map>
+#include <optional>
+#include <set>
 #include <span>
+#include <thread>
 
 #include <shellscalingapi.h>
 #include <wincodec.h>
 
-struct CardLayers {
-    explicit CardLayers(Dx &dx, std::string dxPrelude, std::filesystem::path assetRoot) : dx_(dx) {
-        std::string aeFragment = SlurpTextFile(assetRoot / "Shaders/AtlasEffects.hlsl");
-        std::string draw2dFragment = SlurpTextFile(assetRoot / "Shaders/Draw2D.hlsl");
-
-        std::map<std::string, DivFx> divEffects;
-        DivFxCompiler divFxCompiler(assetRoot, dxPrelude);
-        auto compileAe = std::bind(&DivFxCompiler::Compile, &divFxCompiler, aeFragment, std::placeholders::_1);
-        divEffects["shaper"] = divFxCompiler.Compile(draw2dFragment, "PShad_Tentacles");
-        divEffects["elder"] = divFxCompiler.Compile(draw2dFragment, "PShad_Tentacles");
-        divEffects["crusader"] = compileAe("PShad_CrusaderBackgroundDivEffect");
-        divEffects["redeemer"] = compileAe("PShad_EyrieBackgroundDivEffect");
-        divEffects["hunter"] = compileAe("PShad_BasiliskBackgroundDivEffect");
-        divEffects["warlord"] = compileAe("PShad_ConquerorBackgroundDivEffect");
-
-        std::map<std::string, CComPtr<ID3DBlob>> divPsBytecode;
-        std::map<std::string, CComPtr<ID3D11PixelShader>> divPs;
-        for (auto &[name, dfx] : divEffects) {
-            CComPtr<ID3D11PixelShader> ps;
-            HRESULT hr = dx.dev->CreatePixelShader(dfx.psBytecode->GetBufferPointer(), dfx.psBytecode->GetBufferSize(),
-                                                   nullptr, &ps);
-            divPs[name] = ps;
-            divPsBytecode[name] = dfx.psBytecode;
-        }
-
-        for (auto &name : {"shaper", "elder"}) {
-            Draw2DVariant var{.name = name, .ps = divPs[name], .psBytecode = divPsBytecode[name]};
-            atlasCards_.push_back(std::make_shared<Draw2DLayer>(dx, divFxCompiler, var));
-            names_.push_back(name);
-        }
-        for (auto &name : {"crusader", "redeemer", "hunter", "warlord"}) {
-            AtlasEffectsVariant var{.name = name, .ps = divPs[name], .psBytecode = divPsBytecode[name]};
-            atlasCards_.push_back(std::make_shared<AtlasEffectsLayer>(dx, divFxCompiler, var));
-            names_.push_back(name);
-        }
-    }
-
-    Dx &dx_;
-
-    std::vector<std::shared_ptr<CardLayer>> atlasCards_;
-    std::vector<std::string> names_;
-};
-
 struct App {
     virtual ~App() {}
 
-    virtual void Run(CardLayers const &cardLayers) {}
-
-    glm::mat4 UiMatrix(glm::ivec2 uiSize) {
-        return glm::mat4{{2.0f / uiSize.x, 0, 0, 0},  //
-                         {0, -2.0f / uiSize.y, 0, 0}, //
-                         {0, 0, 1, 0},                //
-                         {-1, 1, 0, 1}};
-    }
+    virtual int Run(CardLayers &cardLayers) { return 0; }
 };
 
 struct InteractiveState : App {
@@ -135,10 +108,22 @@ struct InteractiveState : App {
 
     ~InteractiveState() { glfwTerminate(); }
 
-    void Run(CardLayers const &cardLayers) override {
+    int Run(CardLayers &cardLayers) override {
+        FileWatcher watcher;
+        for (auto &dir : cardLayers.WatchedDirectories()) {
+            watcher.Watch(dir);
+        }
+
         while (!glfwWindowShouldClose(wnd_)) {
             glfwPollEvents();
 
+            if (auto changed = watcher.Poll(); !changed.empty()) {
+                cardLayers.Reload(changed);
+                for (auto &dir : cardLayers.WatchedDirectories()) {
+                    watcher.Watch(dir);
+                }
+            }
+
             double now = glfwGetTime();
 
             float clearColor[4]{0.0f, 0.0f, 0.0f, 0.0f};
@@ -179,6 +164,7 @@ struct InteractiveState : App {
 
             dx_.swapChain->Present(1, 0);
         }
+        return 0;
     }
 
     Dx &dx_;
@@ -188,146 +174,915 @@ struct InteractiveState : App {
     glm::ivec2 fbSize_;
 };
 
-struct BatchState : App {
-    explicit BatchState(Dx &dx, glm::ivec2 animSize, std::filesystem::path exportRoot)
-        : dx_(dx), animSize_(animSize), exportRoot_(exportRoot) {
-        HRESULT hr = S_OK;
-        D3D_FEATURE_LEVEL featureLevel[] = {D3D_FEATURE_LEVEL_11_0};
-        UINT flags = D3D11_CREATE_DEVICE_DEBUG;
-        hr = D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_HARDWARE, nullptr, flags, std::data(featureLevel),
-                               std::size(featureLevel), D3D11_SDK_VERSION, &dx.dev, &dx.featureLevel, &dx.ctx);
-
-        dx.BuildSamplers();
-
-        D3D11_TEXTURE2D_DESC td{
-            .Width = (UINT)animSize.x,
-            .Height = (UINT)animSize.y,
-            .MipLevels = 1,
-            .ArraySize = 1,
-            .Format = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB,
-            .SampleDesc = {1, 0},
-            .Usage = D3D11_USAGE_DEFAULT,
-            .BindFlags = D3D11_BIND_RENDER_TARGET,
-            .CPUAccessFlags = 0,
-            .MiscFlags = 0,
-        };
-        hr = dx.dev->CreateTexture2D(&td, nullptr, &animTex_);
+// Headless card-grid benchmark, see StressSettings.
+struct StressState : App {
+    explicit StressState(Dx &dx, LoopTiming timing, StressSettings settings)
+        : dx_(dx), timing_(timing), settings_(settings) {
+        dx.CreateOffscreenDevice();
+    }
+
+    int Run(CardLayers &cardLayers) override { return RunStress(dx_, cardLayers, timing_, settings_); }
+
+    Dx &dx_;
+    LoopTiming timing_;
+    StressSettings settings_;
+};
 
-        td.Usage = D3D11_USAGE_STAGING;
-        td.BindFlags = 0;
-        td.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
-        hr = dx.dev->CreateTexture2D(&td, nullptr, &animStageTex_);
+// Output path for a numbered frame sequence. Paths only differ in the frame number, so its digits are patched in
+// place rather than formatting a fresh path per frame.
+struct FramePathPattern {
+    // The pattern path ends in "0000.<ext>", those digits are replaced by the frame number.
+    explicit FramePathPattern(std::filesystem::path const &pattern) : path_(pattern.generic_wstring()) {
+        digits_ = path_.rfind(L"0000.");
+    }
 
-        hr = dx.dev->CreateRenderTargetView(animTex_, nullptr, &animRtv_);
+    wchar_t const *For(int frameIdx) {
+        for (int digit = 3, n = frameIdx; digit >= 0; --digit, n /= 10) {
+            path_[digits_ + digit] = L'0' + n % 10;
+        }
+        return path_.c_str();
+    }
+
+  private:
+    std::wstring path_;
+    size_t digits_;
+};
+
+struct BatchState : App {
+    explicit BatchState(Dx &dx, glm::ivec2 animSize, std::filesystem::path exportRoot, ShardSpec shard,
+                        std::optional<DraftSettings> draft = {})
+        : dx_(dx), animSize_(animSize), exportRoot_(exportRoot), shard_(shard), draft_(draft) {
+        dx.CreateOffscreenDevice(D3D11_CREATE_DEVICE_DEBUG);
+        if (draft_) {
+            dx.BuildSamplers(SamplerQuality::Draft);
+            renderer_.emplace(dx, glm::max(animSize / draft_->scale, glm::ivec2{1}), timing_);
+        } else {
+            renderer_.emplace(dx, animSize, timing_);
+        }
 
         std::error_code ec{};
         create_directories(exportRoot_, ec);
     }
 
-    void Run(CardLayers const &cardLayers) override {
-        HRESULT hr{S_OK};
-
-        D3D11_VIEWPORT viewport{.TopLeftX = 0,
-                                .TopLeftY = 0,
-                                .Width = (float)animSize_.x,
-                                .Height = (float)animSize_.y,
-                                .MinDepth = 0.0f,
-                                .MaxDepth = 1.0f};
-
-        dx_.ctx->RSSetViewports(1, &viewport);
-
-        D3D11_RECT scissor{.left = 0, .top = 0, .right = animSize_.x, .bottom = animSize_.y};
-        dx_.ctx->RSSetScissorRects(1, &scissor);
-
-        std::vector<std::vector<int>> specs{{0, 1}, {0, 4}, {0}, {1}, {2}, {3}, {4}, {5}};
-        // for (int cardIdx = 0; cardIdx < cardLayers.atlasCards_.size(); ++cardIdx) {
-        // auto card = cardLayers.atlasCards_[cardIdx];
-        // auto cardName = cardLayers.names_[cardIdx];
-        for (auto layerSpec : specs) {
-            std::vector<std::shared_ptr<CardLayer>> layers;
-            std::string compositeName = "div_bg";
-            for (auto layerSource : layerSpec) {
-                auto card = cardLayers.atlasCards_[layerSource];
-                card->SetViewTransform(UiMatrix(animSize_));
-                compositeName = fmt::format("{}_{}", compositeName, layerSource);
-                layers.push_back(card);
-            }
-
-            float baseTime = 0.0f;
-            int numFrames = 300;
-            float fps = 60.0f;
-            int lerpFrames = 60;
-
-            for (int frameIdx = 0; frameIdx < numFrames; ++frameIdx) {
-                auto captureAt = [&](DirectX::ScratchImage &img, int frame) {
-                    float clearColor[]{0.0f, 0.0f, 0.0f, 1.0f};
-                    dx_.ctx->ClearRenderTargetView(animRtv_, clearColor);
-                    dx_.ctx->OMSetRenderTargets(1, &animRtv_.p, nullptr);
-
-                    for (auto layer : layers) {
-                        layer->SetTime(baseTime + (float)frame / fps);
-                        layer->Draw({0, 0}, animSize_);
+    int Run(CardLayers &cardLayers) override {
+        int failures = 0;
+
+        renderer_->BindViewport();
+
+        int comboEnd = (std::min)(shard_.combos.end, (int)cardLayers.combos_.size());
+        if (compositor_) {
+            failures += ExportCards(cardLayers);
+            comboEnd = shard_.combos.begin;
+        }
+        if (sweep_) {
+            failures += ExportSweep(cardLayers);
+            comboEnd = shard_.combos.begin;
+        }
+        if (packed_) {
+            failures += ExportPacked(cardLayers, {shard_.combos.begin, comboEnd});
+            comboEnd = shard_.combos.begin;
+        }
+        int resumedUnits = 0;
+        for (int comboIdx = shard_.combos.begin; comboIdx < comboEnd; ++comboIdx) {
+            auto &layerSpec = cardLayers.combos_[comboIdx];
+            auto layers = renderer_->ComboLayers(cardLayers, layerSpec);
+            auto compositeName = ComboName(layerSpec);
+            auto ext = Extension(imageFormat_);
+
+            if (splitStatic_) {
+                failures += ExportSplitStatic(layers, compositeName);
+                continue;
+            }
+            if (draft_) {
+                failures += ExportDraft(layers, compositeName);
+                continue;
+            }
+
+            if (frameRing_) {
+                failures += PublishCombo(layers, comboIdx);
+                continue;
+            }
+
+            std::optional<ApngWriter> apng;
+            if (imageFormat_ == ImageFormat::Apng) {
+                apng.emplace(exportRoot_ / fmt::format("{}.png", compositeName), animSize_.x, animSize_.y,
+                             (int)timing_.fps, *pngEncoder_);
+            }
+            FramePathPattern animPath(exportRoot_ / fmt::format("{}-0000.{}", compositeName, ext));
+            // With a checkpoint journal the frames go in units, each recorded once all its files are written.
+            int unitFrames = checkpoint_ ? checkpointFrames_ : shard_.frames.Size();
+            for (int unitBegin = shard_.frames.begin; unitBegin < shard_.frames.end; unitBegin += unitFrames) {
+                IndexRange unit{unitBegin, (std::min)(unitBegin + unitFrames, shard_.frames.end)};
+                std::vector<std::filesystem::path> unitFiles;
+                if (checkpoint_) {
+                    for (int frameIdx = unit.begin; frameIdx < unit.end; ++frameIdx) {
+                        unitFiles.push_back(animPath.For(frameIdx));
+                    }
+                }
+                if (checkpoint_ && checkpoint_->Verified(compositeName, unit, unitFiles)) {
+                    ++resumedUnits;
+                    continue;
+                }
+                int unitFailures = 0;
+                for (int frameIdx = unit.begin; frameIdx < unit.end; ++frameIdx) {
+                    FrameLease frame(renderer_->Pool());
+                    if (!renderer_->RenderFrame(layers, frameIdx, *frame)) {
+                        fmt::print("Frame {} of {} failed to render.\n", frameIdx, compositeName);
+                        ++unitFailures;
+                    } else if (apng) {
+                        apng->AddFrame(*frame);
+                    } else if (!SaveFrame(*frame, {0, 0, animSize_.x, animSize_.y}, animPath.For(frameIdx))) {
+                        fmt::print("Frame {} of {} failed to save.\n", frameIdx, compositeName);
+                        ++unitFailures;
                     }
+                }
+                if (checkpoint_ && !unitFailures && !checkpoint_->Record(compositeName, unit, unitFiles)) {
+                    ++unitFailures;
+                }
+                failures += unitFailures;
+            }
+            if (apng && !apng->Finish()) {
+                ++failures;
+            }
+        }
+        if (resumedUnits) {
+            fmt::print("Resumed past {} checkpointed units whose frames verified.\n", resumedUnits);
+        }
+
+        MemoryReport report;
+        ReportMemory(report, cardLayers);
+        report.Print();
+        if (memoryJson_ && !report.WriteJson(*memoryJson_)) {
+            ++failures;
+        }
+        return failures ? 1 : 0;
+    }
+
+    // Renders a combo's frames straight into the shared memory ring instead of files.
+    int PublishCombo(std::vector<std::shared_ptr<CardLayer>> const &layers, int comboIdx) {
+        int failures = 0;
+        for (int frameIdx = shard_.frames.begin; frameIdx < shard_.frames.end; ++frameIdx) {
+            auto frame = frameRing_->Begin(comboIdx, frameIdx, timing_.TimeAt(frameIdx));
+            if (renderer_->RenderFrame(layers, frameIdx, frame)) {
+                frameRing_->Publish();
+            } else {
+                frameRing_->Discard();
+                ++failures;
+            }
+        }
+        return failures;
+    }
+
+    void ReportMemory(MemoryReport &report, CardLayers const &cardLayers) const {
+        cardLayers.ReportMemory(report);
+        renderer_->ReportMemory(report);
+        report.Add("render target", "packed", ResourceBytes(packedTarget_.tex));
+        report.Add("render target", "packed staging", ResourceBytes(packedTarget_.stageTex));
+        report.Add("render target", "sweep", ResourceBytes(sweepTarget_.tex));
+        report.Add("render target", "sweep staging", ResourceBytes(sweepTarget_.stageTex));
+        auto addPool = [&](char const *name, FramePool const *pool) {
+            if (pool) {
+                auto &stats = pool->Stats();
+                report.Add("frame pool", fmt::format("{} ({} allocations, {} acquires)", name, stats.heapAllocations,
+                                                     stats.acquires),
+                           stats.bytesReserved, stats.peakBytesInUse);
+            }
+        };
+        addPool("packed", packedTarget_.pool.get());
+        addPool("sweep", sweepTarget_.pool.get());
+        addPool("card", cardPool_.get());
+        if (compositor_) {
+            report.Add("card images", "shared static layers", compositor_->CacheBytes());
+        }
+        report.Add("analysis", "temporal stats", temporalStats_.Bytes());
+        report.AddProcessCounters();
+    }
+
+    // Tiles every selected combo into one frame per loop frame. Each combo is drawn exactly as in a single-combo
+    // export and copied into its tile on the GPU, so the packed frame only needs one readback.
+    int ExportPacked(CardLayers const &cardLayers, IndexRange combos) {
+        int failures = 0;
+        std::vector<std::string> names;
+        std::vector<std::vector<int>> specs;
+        std::vector<std::vector<std::shared_ptr<CardLayer>>> comboLayers;
+        for (int comboIdx = combos.begin; comboIdx < combos.end; ++comboIdx) {
+            auto &spec = cardLayers.combos_[comboIdx];
+            names.push_back(ComboName(spec));
+            specs.push_back(spec);
+            comboLayers.push_back(renderer_->ComboLayers(cardLayers, spec));
+        }
+        auto layout = PackTiles(names, specs, animSize_.x, animSize_.y);
+        if (layout.tiles.empty()) {
+            return 0;
+        }
+
+        packedTarget_ = renderer_->CreateTiledTarget(layout.width, layout.height);
+        std::vector<PixelRect> rects;
+        for (auto &tile : layout.tiles) {
+            rects.push_back(tile.rect);
+        }
+
+        auto ext = Extension(imageFormat_);
+        std::string framePattern = fmt::format("div_bg_packed-%04d.{}", ext);
+        FramePathPattern packedPath(exportRoot_ / fmt::format("div_bg_packed-0000.{}", ext));
+        std::optional<ApngWriter> apng;
+        if (imageFormat_ == ImageFormat::Apng) {
+            framePattern = "div_bg_packed.png";
+            apng.emplace(exportRoot_ / framePattern, layout.width, layout.height, (int)timing_.fps, *pngEncoder_);
+        }
+        for (int frameIdx = shard_.frames.begin; frameIdx < shard_.frames.end; ++frameIdx) {
+            FrameLease frame(*packedTarget_.pool);
+            if (!renderer_->RenderTiled(comboLayers, rects, frameIdx, packedTarget_, *frame)) {
+                fmt::print("Packed frame {} failed to render.\n", frameIdx);
+                ++failures;
+            } else if (apng) {
+                apng->AddFrame(*frame);
+            } else if (!SaveFrame(*frame, {0, 0, layout.width, layout.height}, packedPath.For(frameIdx))) {
+                fmt::print("Packed frame {} failed to save.\n", frameIdx);
+                ++failures;
+            }
+        }
+        if (apng && !apng->Finish()) {
+            ++failures;
+        }
+
+        if (!WritePackedManifest(exportRoot_ / "div_bg_packed.json", layout, framePattern, timing_.numFrames,
+                                 timing_.fps)) {
+            ++failures;
+        }
+        return failures;
+    }
+
+    // Renders every variant of a parameter sweep side by side as one labelled video grid. Each variant has its own
+    // layers and cbuffers but shares shaders and textures with the others, and each frame draws all of them into one
+    // tiled target with a single readback.
+    int ExportSweep(CardLayers &cardLayers) {
+        auto &variants = *sweep_;
+        size_t count = variants.layers.size(), depth = variants.layers[0].size();
+        std::vector<std::vector<std::shared_ptr<CardLayer>>> stacks(count);
+        for (size_t layerIdx = 0; layerIdx < depth; ++layerIdx) {
+            std::vector<LayerDesc const *> descs;
+            for (auto &layers : variants.layers) {
+                descs.push_back(&layers[layerIdx]);
+            }
+            auto built = cardLayers.BuildLayerVariants(descs);
+            if (built.size() != count) {
+                fmt::print("The sweep shader for {} failed to compile.\n", descs[0]->name);
+                return 1;
+            }
+            for (size_t i = 0; i < count; ++i) {
+                built[i]->SetViewTransform(UiMatrix(renderer_->Size()));
+                stacks[i].push_back(built[i]);
+            }
+        }
+
+        enum { eLabelHeight = 36 };
+        auto tile = renderer_->Size();
+        int columns = sweepColumns_ ? sweepColumns_ : (int)std::ceil(std::sqrt((double)count));
+        int rows = (int)(count + columns - 1) / columns;
+        int width = columns * tile.x, height = rows * (tile.y + eLabelHeight);
+        sweepTarget_ = renderer_->CreateTiledTarget(width, height);
+        auto &pool = *sweepTarget_.pool;
+
+        // The labels sit in a band under each tile, rasterized once and laid over every frame.
+        CardCompositor labeler(CardLayout{.width = width, .height = height, .background = {0, 0, width, height}}, {});
+        FrameLease labels(pool);
+        for (uint32_t y = 0; y < labels->height; ++y) {
+            memset(labels->Pixel(0, y), 0, 4 * (size_t)labels->width);
+        }
+        std::vector<PixelRect> rects;
+        for (size_t i = 0; i < count; ++i) {
+            PixelRect rect{(int)i % columns * tile.x, (int)i / columns * (tile.y + eLabelHeight), tile.x, tile.y};
+            rects.push_back(rect);
+            CardStaticLayer label{
+                .kind = CardLayerKind::Title,
+                .rect = {rect.x, rect.y + tile.y, tile.x, eLabelHeight},
+                .font = "Segoe UI",
+                .fontSize = 12.0f,
+                .color = 0xFFFFFFFF,
+            };
+            labeler.DrawTitle(variants.labels[i], label, *labels);
+        }
+
+        int failures = 0;
+        auto ext = Extension(imageFormat_);
+        FramePathPattern sweepPath(exportRoot_ / fmt::format("sweep-0000.{}", ext));
+        std::optional<ApngWriter> apng;
+        if (imageFormat_ == ImageFormat::Apng) {
+            apng.emplace(exportRoot_ / "sweep.png", width, height, (int)timing_.fps, *pngEncoder_);
+        }
+        int frameStep = draft_ ? draft_->frameStep : 1;
+        for (int frameIdx = shard_.frames.begin; frameIdx < shard_.frames.end; frameIdx += frameStep) {
+            FrameLease frame(pool), out(pool);
+            if (!renderer_->RenderTiled(stacks, rects, frameIdx, sweepTarget_, *frame)) {
+                fmt::print("Sweep frame {} failed to render.\n", frameIdx);
+                ++failures;
+                continue;
+            }
+            labeler.Composite(*frame, *labels, *out);
+            if (apng) {
+                apng->AddFrame(*out);
+            } else if (!SaveFrame(*out, {0, 0, width, height}, sweepPath.For(frameIdx))) {
+                fmt::print("Sweep frame {} failed to save.\n", frameIdx);
+                ++failures;
+            }
+        }
+        if (apng && !apng->Finish()) {
+            ++failures;
+        }
+        fmt::print("Rendered {} sweep variants in a {}x{} grid.\n", count, columns, rows);
+        return failures;
+    }
+
+    // Renders finished cards for every DivinationCardArt entry. Cards are grouped by their influences so each
+    // background frame is rendered once and composited under the cached static overlay of every card sharing it.
+    // Cards without influences have a still black background and are written as a single image.
+    int ExportCards(CardLayers const &cardLayers) {
+        int failures = 0;
+        auto &layout = compositor_->Layout();
+        if (layout.background.width != animSize_.x || layout.background.height != animSize_.y) {
+            fmt::print("The card layout's background must be {}x{}.\n", animSize_.x, animSize_.y);
+            return 1;
+        }
+        std::map<std::vector<int>, std::vector<DivinationCardArt const *>> byInfluences;
+        for (auto &card : cards_) {
+            bool known = std::all_of(card.influences.begin(), card.influences.end(), [&](int layer) {
+                return layer >= 0 && layer < (int)cardLayers.atlasCards_.size();
+            });
+            if (!known) {
+                fmt::print("Card {} has an unknown influence, skipping it.\n", card.Name());
+                ++failures;
+                continue;
+            }
+            byInfluences[card.influences].push_back(&card);
+        }
+
+        auto cardsRoot = exportRoot_ / "cards";
+        std::error_code ec{};
+        create_directories(cardsRoot, ec);
+        auto ext = Extension(imageFormat_);
+        cardPool_ = std::make_unique<FramePool>(layout.width, layout.height, 2);
+        for (auto &[influences, cards] : byInfluences) {
+            auto layers = renderer_->ComboLayers(cardLayers, influences);
+            std::vector<std::unique_ptr<FrameLease>> overlays;
+            for (auto *card : cards) {
+                overlays.push_back(std::make_unique<FrameLease>(*cardPool_));
+                if (!compositor_->BuildOverlay(*card, **overlays.back())) {
+                    fmt::print("Card {} is missing static layers.\n", card->Name());
+                }
+            }
 
-                    hr = DirectX::CaptureTexture(dx_.dev, dx_.ctx, animTex_, img);
-                };
-                DirectX::ScratchImage frame;
-                captureAt(frame, frameIdx);
-                int oldFrameIdx = frameIdx - numFrames;
-                if (oldFrameIdx >= -lerpFrames) {
-                    DirectX::ScratchImage oldFrame;
-                    captureAt(oldFrame, oldFrameIdx);
-                    float lerpFactor = (oldFrameIdx + lerpFrames + 1.0f) / (lerpFrames + 1.0f);
-                    auto *newImg = frame.GetImage(0, 0, 0);
-                    auto *oldImg = oldFrame.GetImage(0, 0, 0);
-                    for (int i = 0; i < newImg->slicePitch; ++i) {
-                        newImg->pixels[i] = (uint8_t)glm::mix<float>(newImg->pixels[i], oldImg->pixels[i], lerpFactor);
+            if (influences.empty()) {
+                FrameLease background(renderer_->Pool()), out(*cardPool_);
+                if (!renderer_->RenderFrame(layers, 0, *background)) {
+                    fmt::print("The background of {} cards failed to render.\n", cards.size());
+                    failures += (int)cards.size();
+                    continue;
+                }
+                for (size_t i = 0; i < cards.size(); ++i) {
+                    compositor_->Composite(*background, **overlays[i], *out);
+                    auto path = cardsRoot / fmt::format("{}.{}", cards[i]->Name(), ext);
+                    failures += !SaveFrame(*out, {0, 0, layout.width, layout.height}, path.c_str());
+                }
+                continue;
+            }
+
+            std::vector<FramePathPattern> paths;
+            std::vector<std::unique_ptr<ApngWriter>> apngs;
+            for (auto *card : cards) {
+                paths.emplace_back(cardsRoot / fmt::format("{}-0000.{}", card->Name(), ext));
+                if (imageFormat_ == ImageFormat::Apng) {
+                    apngs.push_back(std::make_unique<ApngWriter>(cardsRoot / fmt::format("{}.png", card->Name()),
+                                                                 layout.width, layout.height, (int)timing_.fps,
+                                                                 *pngEncoder_));
+                }
+            }
+            for (int frameIdx = shard_.frames.begin; frameIdx < shard_.frames.end; ++frameIdx) {
+                FrameLease background(renderer_->Pool()), out(*cardPool_);
+                if (!renderer_->RenderFrame(layers, frameIdx, *background)) {
+                    fmt::print("Frame {} of the background of {} cards failed to render.\n", frameIdx, cards.size());
+                    failures += (int)cards.size();
+                    continue;
+                }
+                for (size_t i = 0; i < cards.size(); ++i) {
+                    compositor_->Composite(*background, **overlays[i], *out);
+                    if (!apngs.empty()) {
+                        apngs[i]->AddFrame(*out);
+                    } else if (!SaveFrame(*out, {0, 0, layout.width, layout.height}, paths[i].For(frameIdx))) {
+                        fmt::print("Frame {} of card {} failed to save.\n", frameIdx, cards[i]->Name());
+                        ++failures;
                     }
                 }
+            }
+            for (auto &apng : apngs) {
+                failures += !apng->Finish();
+            }
+        }
+        return failures;
+    }
+
+    // Renders every frameStep-th frame of the shard at the draft resolution into one contact sheet, each frame scaled
+    // back up to the full card size.
+    int ExportDraft(std::vector<std::shared_ptr<CardLayer>> const &layers, std::string const &compositeName) {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<int> frames;
+        for (int frameIdx = shard_.frames.begin; frameIdx < shard_.frames.end; frameIdx += draft_->frameStep) {
+            frames.push_back(frameIdx);
+        }
+        ContactSheet sheet(animSize_.x, animSize_.y, (int)frames.size(), draft_->columns);
+        int failures = 0;
+        for (size_t i = 0; i < frames.size(); ++i) {
+            FrameLease frame(renderer_->Pool());
+            if (!renderer_->RenderFrame(layers, frames[i], *frame)) {
+                fmt::print("Frame {} of {} failed to render, its tile stays black.\n", frames[i], compositeName);
+                ++failures;
+                continue;
+            }
+            sheet.Place((int)i, *frame);
+        }
+        auto path = exportRoot_ / fmt::format("{}-draft.{}", compositeName, Extension(imageFormat_));
+        auto &image = sheet.Frame();
+        if (!SaveFrame(image, {0, 0, (int)image.width, (int)image.height}, path.c_str())) {
+            fmt::print("Draft sheet of {} failed to save.\n", compositeName);
+            return failures + 1;
+        }
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start);
+        auto size = renderer_->Size();
+        fmt::print("Draft of {}: {} frames at {}x{} in {:.2f} s, {}\n", compositeName, frames.size(), size.x, size.y,
+                   elapsed.count(), path.string());
+        return failures;
+    }
+
+    bool SaveFrame(FrameBuffer const &frame, PixelRect rect, wchar_t const *path) {
+        switch (imageFormat_) {
+        case ImageFormat::Png:
+        case ImageFormat::Apng: // single images
+            return pngEncoder_->Encode(frame, rect, encoded_) && WriteBinaryFile(path, encoded_);
+        case ImageFormat::Qoi:
+            return WriteBinaryFile(path, EncodeQoi(frame, rect));
+        }
+        return false;
+    }
+
+    // Renders the whole loop once to find what animates, then writes the loop mean as a static base image and only
+    // the animated regions as frame sequences, with a manifest positioning them. Every shard needs the whole loop's
+    // stats to agree on the regions, but only the shard starting at frame 0 writes the base and the manifest.
+    int ExportSplitStatic(std::vector<std::shared_ptr<CardLayer>> const &layers, std::string const &compositeName) {
+        int failures = 0;
+        auto ext = Extension(imageFormat_);
+        temporalStats_.Reset(animSize_.x, animSize_.y);
+        for (int frameIdx = 0; frameIdx < timing_.numFrames; ++frameIdx) {
+            FrameLease frame(renderer_->Pool());
+            if (!renderer_->RenderFrame(layers, frameIdx, *frame)) {
+                // A loop with frames missing from its stats would misplace the regions and the base.
+                fmt::print("Frame {} of {} failed to render, skipping the combo.\n", frameIdx, compositeName);
+                return 1;
+            }
+            temporalStats_.Accumulate(*frame);
+        }
+        auto regions = FindAnimatedRegions(temporalStats_, splitSettings_);
+
+        RegionManifest manifest{
+            .name = compositeName,
+            .width = animSize_.x,
+            .height = animSize_.y,
+            .base = fmt::format("{}-base.{}", compositeName, ext),
+            .numFrames = timing_.numFrames,
+            .fps = timing_.fps,
+        };
+        bool writesBase = shard_.frames.begin == 0;
+        if (writesBase) {
+            FrameLease base(renderer_->Pool());
+            temporalStats_.MeanInto(*base);
+            if (!SaveFrame(*base, {0, 0, animSize_.x, animSize_.y}, (exportRoot_ / manifest.base).c_str())) {
+                ++failures;
+            }
+        }
 
-                auto animPath = exportRoot_ / fmt::format("{}-{:04d}.png", compositeName, frameIdx);
-                DirectX::DDS_FLAGS exportFlags = DirectX::DDS_FLAGS_NONE;
-                auto img = frame.GetImage(0, 0, 0);
-                hr = DirectX::SaveToWICFile(*img, DirectX::WIC_FLAGS_NONE, DirectX::GetWICCodec(DirectX::WIC_CODEC_PNG),
-                                            animPath.generic_wstring().c_str());
+        std::vector<FramePathPattern> regionPaths;
+        int coveredArea = 0;
+        for (size_t i = 0; i < regions.size(); ++i) {
+            manifest.regions.push_back({regions[i], fmt::format("{}-r{}-%04d.{}", compositeName, i, ext)});
+            regionPaths.emplace_back(exportRoot_ / fmt::format("{}-r{}-0000.{}", compositeName, i, ext));
+            coveredArea += regions[i].Area();
+        }
+        fmt::print("{}: {} animated regions covering {:.1f}% of the frame.\n", compositeName, regions.size(),
+                   100.0 * coveredArea / (animSize_.x * animSize_.y));
+
+        for (int frameIdx = shard_.frames.begin; frameIdx < shard_.frames.end && !regions.empty(); ++frameIdx) {
+            FrameLease frame(renderer_->Pool());
+            if (!renderer_->RenderFrame(layers, frameIdx, *frame)) {
+                fmt::print("Frame {} of {} failed to render.\n", frameIdx, compositeName);
+                ++failures;
+                continue;
+            }
+            for (size_t i = 0; i < regions.size(); ++i) {
+                if (!SaveFrame(*frame, regions[i], regionPaths[i].For(frameIdx))) {
+                    fmt::print("Region {} of frame {} of {} failed to save.\n", i, frameIdx, compositeName);
+                    ++failures;
+                }
             }
         }
+
+        if (writesBase && !WriteRegionManifest(exportRoot_ / fmt::format("{}.json", compositeName), manifest)) {
+            ++failures;
+        }
+        return failures;
     }
 
     Dx &dx_;
 
     glm::ivec2 animSize_;
     std::filesystem::path exportRoot_;
+    ShardSpec shard_;
+    LoopTiming timing_;
+
+    bool packed_{};
+    bool splitStatic_{};
+    std::optional<DraftSettings> draft_; // set to preview a contact sheet instead of exporting frames
+    std::optional<SweepVariants> sweep_; // set to render a parameter sweep instead of the combos
+    int sweepColumns_{};
+    ImageFormat imageFormat_ = ImageFormat::Png;
+    std::unique_ptr<PngEncoder> pngEncoder_;
+    std::vector<uint8_t> encoded_; // the last saved image, reused across frames
+
+    std::vector<DivinationCardArt> cards_;
+    std::unique_ptr<CardCompositor> compositor_; // set to export finished cards instead of backgrounds
+    std::unique_ptr<FramePool> cardPool_;
+    RegionSplitSettings splitSettings_;
+    TemporalStats temporalStats_;
+
+    TiledTarget packedTarget_, sweepTarget_;
+
+    std::optional<std::filesystem::path> memoryJson_;
+    std::unique_ptr<FrameRing> frameRing_; // set to publish frames to shared memory instead of files
+    std::unique_ptr<CheckpointJournal> checkpoint_; // set to record finished units and skip them on a rerun
+    int checkpointFrames_ = 50;
 
-    CComPtr<ID3D11Texture2D> animTex_, animStageTex_;
-    CComPtr<ID3D11RenderTargetView> animRtv_;
+    std::optional<LoopRenderer> renderer_; // created once the device exists
 };
 
-int main(int argc, char *argv[]) {
+struct Options {
     std::filesystem::path assetRoot = R"(F:\Temp\poe\contents-3.20.1b)";
     std::filesystem::path preludeRoot = R"(F:\Temp\poe\prelude)";
+    std::filesystem::path exportRoot = R"(F:\Temp\poe\div-export\raw)";
+    std::optional<std::filesystem::path> layersPath; // defaults to layers.txt in the prelude root
+    bool interactive = false;
+    ShaderProfile shaderProfile = ShaderProfile::Release;
+
+    std::optional<IndexRange> combos, frames;
+
+    bool coordinate = false;
+    int workers = 0;
+    std::vector<std::wstring> workerCommands;
+    int framesPerShard = 50;
+
+    bool splitStatic = false;
+    bool packed = false;
+    std::optional<DraftSettings> draft;
+    std::optional<std::filesystem::path> sweepPath;
+    std::optional<StressSettings> stress;
+    std::optional<std::wstring> ringName;
+    bool checkpoint = false;
+    int checkpointFrames = 50;
+    int ringSlots = 8;
+    std::optional<int> crossfadeTolerance; // set to blend the crossfade in fixed point within this many levels
+    std::optional<std::filesystem::path> memoryJson;
+    ImageFormat imageFormat = ImageFormat::Png;
+    PngSettings pngSettings;
+    std::optional<std::filesystem::path> cardTable, cardLayoutPath;
+    int maxAttempts = 3;
+};
+
+std::optional<Options> ParseOptions(int argc, char *argv[]) {
+    Options opts;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        auto value = [&]() -> char const * { return i + 1 < argc ? argv[++i] : nullptr; };
+        char const *v{};
+        if (arg == "--interactive") {
+            opts.interactive = true;
+        } else if (arg == "--shader-debug") {
+            opts.shaderProfile = ShaderProfile::Debug;
+        } else if (arg == "--memory-json" && (v = value())) {
+            opts.memoryJson = v;
+        } else if (arg == "--format" && (v = value())) {
+            if (v == std::string_view("png")) {
+                opts.imageFormat = ImageFormat::Png;
+            } else if (v == std::string_view("qoi")) {
+                opts.imageFormat = ImageFormat::Qoi;
+            } else if (v == std::string_view("apng")) {
+                opts.imageFormat = ImageFormat::Apng;
+            } else {
+                fmt::print("Unknown image format: {}\n", v);
+                return std::nullopt;
+            }
+        } else if (arg == "--png-level" && (v = value())) {
+            opts.pngSettings.level = atoi(v);
+        } else if (arg == "--png-threads" && (v = value())) {
+            opts.pngSettings.threads = atoi(v);
+        } else if (arg == "--cards" && (v = value())) {
+            opts.cardTable = v;
+        } else if (arg == "--card-layout" && (v = value())) {
+            opts.cardLayoutPath = v;
+        } else if (arg == "--draft") {
+            opts.draft = opts.draft.value_or(DraftSettings{});
+        } else if (arg == "--draft-scale" && (v = value())) {
+            opts.draft = opts.draft.value_or(DraftSettings{});
+            opts.draft->scale = (std::max)(atoi(v), 1);
+        } else if (arg == "--draft-step" && (v = value())) {
+            opts.draft = opts.draft.value_or(DraftSettings{});
+            opts.draft->frameStep = (std::max)(atoi(v), 1);
+        } else if (arg == "--checkpoint") {
+            opts.checkpoint = true;
+        } else if (arg == "--checkpoint-frames" && (v = value())) {
+            opts.checkpoint = true;
+            opts.checkpointFrames = (std::max)(atoi(v), 1);
+        } else if (arg == "--ring" && (v = value())) {
+            opts.ringName = std::filesystem::path(v).wstring();
+        } else if (arg == "--ring-slots" && (v = value())) {
+            opts.ringSlots = (std::max)(atoi(v), 2);
+        } else if (arg == "--crossfade-tolerance" && (v = value())) {
+            opts.crossfadeTolerance = (std::max)(atoi(v), 0);
+        } else if (arg == "--stress" && (v = value())) {
+            opts.stress = opts.stress.value_or(StressSettings{});
+            opts.stress->maxCards = (std::max)(atoi(v), 1);
+        } else if (arg == "--stress-frames" && (v = value())) {
+            opts.stress = opts.stress.value_or(StressSettings{});
+            opts.stress->frames = (std::max)(atoi(v), 1);
+        } else if (arg == "--sweep" && (v = value())) {
+            opts.sweepPath = v;
+        } else if (arg == "--packed") {
+            opts.packed = true;
+        } else if (arg == "--split-static") {
+            opts.splitStatic = true;
+        } else if (arg == "--coordinate") {
+            opts.coordinate = true;
+        } else if (arg == "--asset-root" && (v = value())) {
+            opts.assetRoot = v;
+        } else if (arg == "--prelude-root" && (v = value())) {
+            opts.preludeRoot = v;
+        } else if (arg == "--layers" && (v = value())) {
+            opts.layersPath = v;
+        } else if (arg == "--out" && (v = value())) {
+            opts.exportRoot = v;
+        } else if (arg == "--combos" && (v = value())) {
+            opts.combos = ParseIndexRange(v);
+            if (!opts.combos) {
+                fmt::print("Invalid combo range: {}\n", v);
+                return std::nullopt;
+            }
+        } else if (arg == "--frames" && (v = value())) {
+            opts.frames = ParseIndexRange(v);
+            if (!opts.frames) {
+                fmt::print("Invalid frame range: {}\n", v);
+                return std::nullopt;
+            }
+        } else if (arg == "--workers" && (v = value())) {
+            opts.workers = atoi(v);
+        } else if (arg == "--worker-cmd" && (v = value())) {
+            opts.workerCommands.push_back(std::filesystem::path(v).wstring());
+        } else if (arg == "--frames-per-shard" && (v = value())) {
+            opts.framesPerShard = atoi(v);
+        } else if (arg == "--retries" && (v = value())) {
+            opts.maxAttempts = 1 + atoi(v);
+        } else {
+            fmt::print("Unknown or incomplete argument: {}\n", arg);
+            return std::nullopt;
+        }
+    }
+    return opts;
+}
+
+// Splits the batch into shards and farms them out to worker processes, each running this executable (or a
+// --worker-cmd wrapper such as a remote shell to a render node) on one shard.
+int RunCoordinator(Options const &opts, LayerCatalog const &catalog, LoopTiming const &timing) {
+    ShardCoordinatorSettings settings{.exportRoot = opts.exportRoot, .maxAttempts = opts.maxAttempts};
+    settings.workerCommands = opts.workerCommands;
+    if (settings.workerCommands.empty()) {
+        wchar_t selfPath[MAX_PATH]{};
+        GetModuleFileNameW(nullptr, selfPath, MAX_PATH);
+        auto self = fmt::format(L"\"{}\" --asset-root \"{}\" --prelude-root \"{}\"", selfPath,
+                                opts.assetRoot.wstring(), opts.preludeRoot.wstring());
+        if (opts.layersPath) {
+            self += fmt::format(L" --layers \"{}\"", opts.layersPath->wstring());
+        }
+        int workers = opts.workers > 0 ? opts.workers
+                                       : (std::min)((int)std::thread::hardware_concurrency(), MAXIMUM_WAIT_OBJECTS);
+        settings.workerCommands.assign((std::max)(workers, 1), self);
+    }
+    // Options that change how frames are rendered or encoded go to every worker, local or not; the paths are up to
+    // a --worker-cmd, as they may differ on its node. Workers run side by side, so each encodes on one thread.
+    auto renderArgs = fmt::format(L" --format {} --png-level {} --png-threads 1",
+                                  std::filesystem::path(Extension(opts.imageFormat)).wstring(), opts.pngSettings.level);
+    if (opts.crossfadeTolerance) {
+        renderArgs += fmt::format(L" --crossfade-tolerance {}", *opts.crossfadeTolerance);
+    }
+    if (opts.shaderProfile == ShaderProfile::Debug) {
+        renderArgs += L" --shader-debug";
+    }
+    for (auto &command : settings.workerCommands) {
+        command += renderArgs;
+    }
+
+    auto combos = opts.combos.value_or(IndexRange{0, (int)catalog.combos.size()});
+    combos.end = (std::min)(combos.end, (int)catalog.combos.size());
+    auto frames = opts.frames.value_or(IndexRange{0, timing.numFrames});
+    frames.end = (std::min)(frames.end, timing.numFrames);
+    std::vector<ShardSpec> shards;
+    for (auto &shard : PlanShards(combos.Size(), frames.Size(), opts.framesPerShard, opts.packed)) {
+        shard.combos.begin += combos.begin;
+        shard.combos.end += combos.begin;
+        shard.frames.begin += frames.begin;
+        shard.frames.end += frames.begin;
+        shards.push_back(shard);
+    }
+
+    std::error_code ec{};
+    create_directories(opts.exportRoot, ec);
+    ShardCoordinator coordinator(settings);
+    return coordinator.Run(shards) ? 0 : 1;
+}
+
+// Fingerprint of everything a checkpointed export's frames depend on: the layer catalog, every shader source, the
+// textures the layers bind, and the settings that change the pixels or the files. Textures count by size and time of
+// last change rather than contents, which would mean reading the whole asset tree on every start.
+uint64_t CheckpointFingerprint(Options const &opts, LayerCatalog const &catalog, CardLayers const &cardLayers,
+                               Dx const &dx, LoopTiming const &timing, glm::ivec2 animSize) {
+    auto files = cardLayers.ShaderSources();
+    files.insert(files.begin(), opts.layersPath.value_or(opts.preludeRoot / "layers.txt"));
+    std::string inputs = fmt::format("shaders {:016x}\n", HashFiles(files).value_or(0));
+    inputs += fmt::format("size {}x{} frames {} fps {} lerp {} base {}\n", animSize.x, animSize.y, timing.numFrames,
+                          timing.fps, timing.lerpFrames, timing.baseTime);
+    inputs += fmt::format("profile {} crossfade-tolerance {} format {} png-level {} checkpoint-frames {}\n",
+                          (int)opts.shaderProfile, opts.crossfadeTolerance.value_or(-1), (int)opts.imageFormat,
+                          opts.pngSettings.level, opts.checkpointFrames);
+    std::set<std::string> textures;
+    for (auto &desc : catalog.layers) {
+        for (auto &texDesc : desc.textures) {
+            if (!texDesc.solid && !texDesc.path.empty()) {
+                textures.insert(texDesc.path);
+            }
+        }
+    }
+    for (auto &texture : textures) {
+        for (auto &root : dx.resourceRoots_) {
+            std::error_code ec;
+            auto path = root / texture;
+            auto size = file_size(path, ec);
+            if (!ec) {
+                auto changed = last_write_time(path, ec).time_since_epoch().count();
+                inputs += fmt::format("texture {} {} {}\n", path.string(), size, changed);
+                break;
+            }
+        }
+    }
+    return HashBytes(inputs.data(), inputs.size());
+}
+
+int main(int argc, char *argv[]) {
+    auto parsed = ParseOptions(argc, argv);
+    if (!parsed) {
+        return 2;
+    }
+    auto &opts = *parsed;
+    auto &assetRoot = opts.assetRoot;
+    auto &preludeRoot = opts.preludeRoot;
+
+    auto catalog = LoadLayerCatalog(opts.layersPath.value_or(preludeRoot / "layers.txt"));
+    if (!catalog) {
+        return 2;
+    }
+
+    if (opts.packed && opts.splitStatic) {
+        fmt::print("--packed and --split-static are separate output modes.\n");
+        return 2;
+    }
+
+    // A sub-range would be written as a loop of its own under the whole loop's name.
+    if (opts.imageFormat == ImageFormat::Apng && (opts.splitStatic || opts.coordinate || opts.frames)) {
+        fmt::print("--format apng writes whole loops and works without --split-static, --coordinate and --frames.\n");
+        return 2;
+    }
+
+    if (opts.cardTable && (opts.packed || opts.splitStatic || opts.coordinate)) {
+        fmt::print("--cards is a separate output mode from --packed, --split-static and --coordinate.\n");
+        return 2;
+    }
+
+    if (opts.sweepPath && (opts.packed || opts.splitStatic || opts.cardTable || opts.coordinate || opts.interactive)) {
+        fmt::print("--sweep is a separate output mode from --packed, --split-static, --cards and --coordinate.\n");
+        return 2;
+    }
+
+    if (opts.draft && (opts.packed || opts.splitStatic || opts.cardTable || opts.coordinate ||
+                       opts.interactive || opts.imageFormat == ImageFormat::Apng)) {
+        fmt::print("--draft previews combinations or a --sweep, without other output modes or --format apng.\n");
+        return 2;
+    }
+
+    if (opts.checkpoint && (opts.packed || opts.splitStatic || opts.cardTable || opts.sweepPath || opts.draft ||
+                            opts.coordinate || opts.interactive || opts.ringName ||
+                            opts.imageFormat == ImageFormat::Apng)) {
+        fmt::print("--checkpoint resumes plain combination exports written one file per frame.\n");
+        return 2;
+    }
+
+    if (opts.ringName && (opts.packed || opts.splitStatic || opts.cardTable || opts.sweepPath || opts.draft ||
+                          opts.coordinate || opts.interactive || opts.imageFormat == ImageFormat::Apng)) {
+        fmt::print("--ring publishes plain combination frames and is a separate output mode from all others.\n");
+        return 2;
+    }
+
+    LoopTiming timing;
+    if (opts.coordinate) {
+        if (opts.splitStatic) {
+            fmt::print("--split-static analyses whole loops and is not supported with --coordinate.\n");
+            return 2;
+        }
+        if (opts.layersPath && !opts.workerCommands.empty()) {
+            fmt::print("--layers is not passed on to --worker-cmd commands; give it in each command instead.\n");
+            return 2;
+        }
+        return RunCoordinator(opts, *catalog, timing);
+    }
 
     CoInitialize(nullptr);
 
-    bool interactive = false;
     glm::ivec2 fbSize{1920, 1080};
     glm::ivec2 animSize{eCardWidth, eCardHeight};
-    std::filesystem::path exportRoot = R"(F:\Temp\poe\div-export\raw)";
 
     Dx dx;
     dx.AddResourceRoot(assetRoot);
     dx.AddResourceRoot(preludeRoot);
 
     std::unique_ptr<App> app;
+    BatchState *batchState{}; // set when exporting, for setup that needs the compiled layers
 
-    if (interactive) {
+    if (opts.interactive) {
         app = std::make_unique<InteractiveState>(dx, fbSize);
+    } else if (opts.stress) {
+        app = std::make_unique<StressState>(dx, timing, *opts.stress);
     } else {
-        app = std::make_unique<BatchState>(dx, animSize, exportRoot);
+        ShardSpec shard{
+            .combos = opts.combos.value_or(IndexRange{0, (int)catalog->combos.size()}),
+            .frames = opts.frames.value_or(IndexRange{0, timing.numFrames}),
+        };
+        shard.frames.end = (std::min)(shard.frames.end, timing.numFrames);
+        auto batch = std::make_unique<BatchState>(dx, animSize, opts.exportRoot, shard, opts.draft);
+        batch->splitStatic_ = opts.splitStatic;
+        batch->packed_ = opts.packed;
+        batch->memoryJson_ = opts.memoryJson;
+        batch->imageFormat_ = opts.imageFormat;
+        batch->pngEncoder_ = std::make_unique<PngEncoder>(opts.pngSettings);
+        batch->checkpointFrames_ = opts.checkpointFrames;
+        if (opts.ringName) {
+            batch->frameRing_ = FrameRing::Create(*opts.ringName, animSize.x, animSize.y, opts.ringSlots);
+            if (!batch->frameRing_) {
+                return 2;
+            }
+        }
+        if (opts.crossfadeTolerance) {
+            int error = batch->renderer_->UseFixedCrossfade(*opts.crossfadeTolerance);
+            if (error < 0) {
+                fmt::print("No crossfade weight blends within {} levels in fixed point, keeping fp32.\n",
+                           *opts.crossfadeTolerance);
+            } else {
+                fmt::print("Crossfade blends in fixed point, at most {} levels from fp32.\n", error);
+            }
+        }
+        if (opts.sweepPath) {
+            auto spec = LoadSweepSpec(*opts.sweepPath);
+            auto variants = spec ? ExpandSweep(*spec, *catalog) : std::nullopt;
+            if (!variants) {
+                return 2;
+            }
+            batch->sweep_ = std::move(*variants);
+            batch->sweepColumns_ = spec->columns;
+        }
+        if (opts.cardTable) {
+            auto cards = LoadDivinationCardArt(*opts.cardTable);
+            auto layout = LoadCardLayout(opts.cardLayoutPath.value_or(preludeRoot / "card.txt"));
+            if (!cards || !layout) {
+                return 2;
+            }
+            batch->cards_ = std::move(*cards);
+            batch->compositor_ = std::make_unique<CardCompositor>(*layout, dx.resourceRoots_);
+        }
+        batchState = batch.get();
+        app = std::move(batch);
     }
 
-    std::string dxPrelude = SlurpTextFile(preludeRoot / "dx11_prelude.inc");
-    CardLayers cardLayers(dx, dxPrelude, assetRoot);
+    CardLayers cardLayers(dx, preludeRoot / "dx11_prelude.inc", assetRoot, *catalog, opts.shaderProfile);
+    // The journal is only trusted for the inputs it was written with, which include every compiled shader source.
+    if (batchState && opts.checkpoint) {
+        batchState->checkpoint_ = std::make_unique<CheckpointJournal>(
+            opts.exportRoot / "divfx-checkpoint.txt",
+            CheckpointFingerprint(opts, *catalog, cardLayers, dx, timing, animSize));
+        if (auto units = batchState->checkpoint_->RecordedUnits()) {
+            fmt::print("Checkpoint journal lists {} finished units, verifying them before resuming.\n", units);
+        }
+    }
 
-    app->Run(cardLayers);
-}
\ No newline at end of file
+    return app->Run(cardLayers);
+}
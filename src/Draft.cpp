@@ -0,0 +1,47 @@
+#include "Draft.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+void UpscaleInto(FrameBuffer const &src, FrameBuffer &dst, PixelRect rect) {
+    // Sample positions are pixel centres mapped back into the source, clamped at its edges.
+    float scaleX = (float)src.width / rect.width, scaleY = (float)src.height / rect.height;
+    int maxX = (int)src.width - 1, maxY = (int)src.height - 1;
+    for (int y = 0; y < rect.height; ++y) {
+        float sy = (std::max)((y + 0.5f) * scaleY - 0.5f, 0.0f);
+        int y0 = (std::min)((int)sy, maxY), y1 = (std::min)(y0 + 1, maxY);
+        float fy = sy - y0;
+        uint8_t *out = dst.Pixel(rect.x, rect.y + y);
+        for (int x = 0; x < rect.width; ++x, out += 4) {
+            float sx = (std::max)((x + 0.5f) * scaleX - 0.5f, 0.0f);
+            int x0 = (std::min)((int)sx, maxX), x1 = (std::min)(x0 + 1, maxX);
+            float fx = sx - x0;
+            uint8_t const *p00 = src.Pixel(x0, y0), *p01 = src.Pixel(x1, y0);
+            uint8_t const *p10 = src.Pixel(x0, y1), *p11 = src.Pixel(x1, y1);
+            for (int c = 0; c < 4; ++c) {
+                float top = p00[c] + (p01[c] - p00[c]) * fx;
+                float bottom = p10[c] + (p11[c] - p10[c]) * fx;
+                out[c] = (uint8_t)std::lround(top + (bottom - top) * fy);
+            }
+        }
+    }
+}
+
+ContactSheet::ContactSheet(int cellWidth, int cellHeight, int cells, int columns)
+    : cellWidth_(cellWidth), cellHeight_(cellHeight), columns_((std::max)((std::min)(columns, cells), 1)) {
+    int rows = (std::max)((cells + columns_ - 1) / columns_, 1);
+    frame_.width = cellWidth * columns_;
+    frame_.height = cellHeight * rows;
+    frame_.rowPitch = 4 * (size_t)frame_.width;
+    storage_.resize(frame_.SizeBytes());
+    // Empty cells stay opaque black, like the background the layers are drawn over.
+    for (size_t i = 3; i < storage_.size(); i += 4) {
+        storage_[i] = 0xFF;
+    }
+    frame_.pixels = storage_.data();
+}
+
+void ContactSheet::Place(int cell, FrameBuffer const &frame) {
+    PixelRect rect{(cell % columns_) * cellWidth_, (cell / columns_) * cellHeight_, cellWidth_, cellHeight_};
+    UpscaleInto(frame, frame_, rect);
+}
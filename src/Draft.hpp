@@ -0,0 +1,32 @@
+#pragma once
+
+#include "FramePool.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Quick preview of a loop: every frameStep-th frame of the full export, rendered at 1/scale of its resolution with
+// cheaper texture filtering. Frames keep their full-export indices, so each draft frame shows the same moment as the
+// frame of that number in the final sequence.
+struct DraftSettings {
+    int scale = 2;
+    int frameStep = 10;
+    int columns = 6;
+};
+
+// Bilinear resize of a whole frame into a rectangle of another frame.
+void UpscaleInto(FrameBuffer const &src, FrameBuffer &dst, PixelRect rect);
+
+// Grid of frames, each scaled up to the cell size, left to right and top to bottom.
+struct ContactSheet {
+    ContactSheet(int cellWidth, int cellHeight, int cells, int columns);
+
+    void Place(int cell, FrameBuffer const &frame);
+
+    FrameBuffer const &Frame() const { return frame_; }
+
+  private:
+    int cellWidth_, cellHeight_, columns_;
+    std::vector<uint8_t> storage_;
+    FrameBuffer frame_;
+};
@@ -0,0 +1,86 @@
+#include "FileWatcher.hpp"
+#include "Util.hpp"
+
+#include <fmt/format.h>
+
+#include <utility>
+
+FileWatcher::~FileWatcher() {
+    for (auto &dir : dirs_) {
+        CancelIoEx(dir->handle, &dir->overlapped);
+        DWORD bytes{};
+        GetOverlappedResult(dir->handle, &dir->overlapped, &bytes, TRUE);
+        CloseHandle(dir->overlapped.hEvent);
+        CloseHandle(dir->handle);
+    }
+}
+
+bool FileWatcher::Watch(std::filesystem::path const &dir) {
+    auto key = PathKey(dir);
+    for (auto &watched : dirs_) {
+        if (watched->key == key) {
+            return true;
+        }
+    }
+    auto watched = std::make_unique<Directory>();
+    watched->root = dir;
+    watched->key = key;
+    watched->handle = CreateFileW(dir.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                  nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+    if (watched->handle == INVALID_HANDLE_VALUE) {
+        fmt::print("Could not watch {} for changes.\n", dir.string());
+        return false;
+    }
+    watched->overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (!Issue(*watched)) {
+        CloseHandle(watched->overlapped.hEvent);
+        CloseHandle(watched->handle);
+        fmt::print("Could not watch {} for changes.\n", dir.string());
+        return false;
+    }
+    dirs_.push_back(std::move(watched));
+    return true;
+}
+
+bool FileWatcher::Issue(Directory &dir) {
+    ResetEvent(dir.overlapped.hEvent);
+    DWORD filter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE;
+    return ReadDirectoryChangesW(dir.handle, dir.buffer.data(), (DWORD)dir.buffer.size(), FALSE, filter, nullptr,
+                                 &dir.overlapped, nullptr);
+}
+
+std::vector<std::filesystem::path> FileWatcher::Poll() {
+    auto now = std::chrono::steady_clock::now();
+    auto note = [&](std::filesystem::path const &path) {
+        if (pendingKeys_.insert(PathKey(path)).second) {
+            pending_.push_back(path);
+        }
+        lastChange_ = now;
+    };
+    for (auto &dir : dirs_) {
+        DWORD bytes{};
+        if (!GetOverlappedResult(dir->handle, &dir->overlapped, &bytes, FALSE)) {
+            continue; // still pending
+        }
+        if (bytes == 0) {
+            note(dir->root);
+        }
+        for (size_t offset = 0; offset < bytes;) {
+            auto *info = (FILE_NOTIFY_INFORMATION const *)(dir->buffer.data() + offset);
+            if (info->Action != FILE_ACTION_REMOVED && info->Action != FILE_ACTION_RENAMED_OLD_NAME) {
+                note(dir->root / std::wstring_view(info->FileName, info->FileNameLength / sizeof(wchar_t)));
+            }
+            if (!info->NextEntryOffset) {
+                break;
+            }
+            offset += info->NextEntryOffset;
+        }
+        Issue(*dir);
+    }
+
+    if (pending_.empty() || now - lastChange_ < settleTime_) {
+        return {};
+    }
+    pendingKeys_.clear();
+    return std::exchange(pending_, {});
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <windows.h>
+
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+// Watches directories for changed files without blocking, so the preview can pick up edits between frames.
+struct FileWatcher {
+    FileWatcher() = default;
+    FileWatcher(FileWatcher const &) = delete;
+    FileWatcher &operator=(FileWatcher const &) = delete;
+    ~FileWatcher();
+
+    // Starts watching the files directly in dir; directories already watched are ignored.
+    bool Watch(std::filesystem::path const &dir);
+
+    // Returns the files changed since the last batch once no change has arrived for the settle time, so an editor
+    // saving through several writes or a rename triggers one reload. A directory whose change list overflowed is
+    // returned in place of its files.
+    std::vector<std::filesystem::path> Poll();
+
+  private:
+    struct Directory {
+        std::filesystem::path root;
+        std::string key;
+        HANDLE handle{INVALID_HANDLE_VALUE};
+        OVERLAPPED overlapped{};
+        alignas(DWORD) std::array<std::byte, 16384> buffer;
+    };
+
+    bool Issue(Directory &dir);
+
+    std::vector<std::unique_ptr<Directory>> dirs_;
+    std::set<std::string> pendingKeys_;
+    std::vector<std::filesystem::path> pending_;
+    std::chrono::steady_clock::time_point lastChange_;
+    std::chrono::milliseconds settleTime_{100};
+};
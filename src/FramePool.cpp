@@ -0,0 +1,125 @@
+#include "FramePool.hpp"
+
+#include <algorithm>
+#include <new>
+
+namespace {
+uint8_t *AlignedAlloc(size_t size) {
+    return static_cast<uint8_t *>(::operator new(size, std::align_val_t{eFrameAlignment}));
+}
+
+void AlignedFree(uint8_t *p) { ::operator delete(p, std::align_val_t{eFrameAlignment}); }
+
+size_t AlignUp(size_t n, size_t alignment) { return (n + alignment - 1) / alignment * alignment; }
+} // namespace
+
+FramePool::FramePool(uint32_t width, uint32_t height, size_t initialCount)
+    : width_(width), height_(height), rowPitch_(AlignUp(4 * (size_t)width, eFrameAlignment)) {
+    all_.reserve(initialCount);
+    free_.reserve(initialCount);
+    for (size_t i = 0; i < initialCount; ++i) {
+        free_.push_back(Grow());
+    }
+}
+
+FramePool::~FramePool() {
+    for (auto *frame : all_) {
+        AlignedFree(frame->pixels);
+        delete frame;
+    }
+}
+
+FrameBuffer *FramePool::Grow() {
+    auto *frame = new FrameBuffer{.width = width_, .height = height_, .rowPitch = rowPitch_};
+    frame->pixels = AlignedAlloc(frame->SizeBytes());
+    all_.push_back(frame);
+    stats_.heapAllocations += 2;
+    stats_.bytesReserved += frame->SizeBytes();
+    return frame;
+}
+
+FrameBuffer *FramePool::Acquire() {
+    FrameBuffer *frame{};
+    if (free_.empty()) {
+        frame = Grow();
+        free_.reserve(all_.size());
+    } else {
+        frame = free_.back();
+        free_.pop_back();
+    }
+    ++stats_.acquires;
+    stats_.bytesInUse += frame->SizeBytes();
+    stats_.peakBytesInUse = (std::max)(stats_.peakBytesInUse, stats_.bytesInUse);
+    return frame;
+}
+
+void FramePool::Release(FrameBuffer *frame) {
+    if (!frame) {
+        return;
+    }
+    stats_.bytesInUse -= frame->SizeBytes();
+    free_.push_back(frame);
+}
+
+FrameArena::FrameArena(size_t capacity) {
+    if (capacity) {
+        head_ = NewBlock(capacity);
+    }
+}
+
+FrameArena::~FrameArena() {
+    for (auto &block : spill_) {
+        AlignedFree(block.base);
+    }
+    if (head_.base) {
+        AlignedFree(head_.base);
+    }
+}
+
+FrameArena::Block FrameArena::NewBlock(size_t size) {
+    size = AlignUp(size, eFrameAlignment);
+    ++stats_.heapAllocations;
+    stats_.bytesReserved += size;
+    return Block{AlignedAlloc(size), size};
+}
+
+void *FrameArena::Allocate(size_t size, size_t alignment) {
+    ++stats_.acquires;
+    // Blocks are only eFrameAlignment aligned, so larger alignments are applied to the address, not the offset.
+    size_t offset = head_.base ? AlignUp((uintptr_t)head_.base + used_, alignment) - (uintptr_t)head_.base : 0;
+    if (head_.base && offset + size <= head_.size) {
+        used_ = offset + size;
+        stats_.bytesInUse = used_ + spillUsed_;
+        stats_.peakBytesInUse = (std::max)(stats_.peakBytesInUse, stats_.bytesInUse);
+        return head_.base + offset;
+    }
+
+    // Out of room in the head block; hand out a dedicated block and remember to grow on Reset.
+    size_t slack = alignment > eFrameAlignment ? alignment - eFrameAlignment : 0;
+    size_t blockSize = AlignUp(size, alignment) + slack;
+    spill_.push_back(NewBlock(blockSize));
+    spillUsed_ += blockSize;
+    stats_.bytesInUse = used_ + spillUsed_;
+    stats_.peakBytesInUse = (std::max)(stats_.peakBytesInUse, stats_.bytesInUse);
+    return reinterpret_cast<uint8_t *>(AlignUp((uintptr_t)spill_.back().base, alignment));
+}
+
+void FrameArena::Reset() {
+    if (!spill_.empty()) {
+        size_t capacity = head_.size;
+        for (auto &block : spill_) {
+            capacity += block.size;
+            stats_.bytesReserved -= block.size;
+            AlignedFree(block.base);
+        }
+        spill_.clear();
+        if (head_.base) {
+            stats_.bytesReserved -= head_.size;
+            AlignedFree(head_.base);
+        }
+        head_ = NewBlock(capacity);
+    }
+    used_ = 0;
+    spillUsed_ = 0;
+    stats_.bytesInUse = 0;
+}
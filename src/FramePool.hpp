@@ -0,0 +1,106 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum { eFrameAlignment = 64 };
+
+struct PixelRect {
+    int x{}, y{}, width{}, height{};
+
+    int Area() const { return width * height; }
+    bool Empty() const { return width <= 0 || height <= 0; }
+};
+
+// Aligned storage for one tightly packed 32bpp frame.
+struct FrameBuffer {
+    uint32_t width{}, height{};
+    size_t rowPitch{};
+    uint8_t *pixels{};
+
+    size_t SizeBytes() const { return rowPitch * height; }
+    uint8_t *Pixel(int x, int y) const { return pixels + y * rowPitch + 4 * x; }
+};
+
+struct FramePoolStats {
+    size_t heapAllocations{}; // backing allocations made by the pool or arena
+    size_t acquires{};
+    size_t bytesReserved{};
+    size_t bytesInUse{};
+    size_t peakBytesInUse{};
+};
+
+// Preallocated set of equally sized frame buffers. Acquire only allocates when every buffer is out, so a batch
+// that returns its frames before the next one settles at zero allocations per frame.
+struct FramePool {
+    FramePool(uint32_t width, uint32_t height, size_t initialCount);
+    ~FramePool();
+
+    FramePool(FramePool const &) = delete;
+    FramePool &operator=(FramePool const &) = delete;
+
+    FrameBuffer *Acquire();
+    void Release(FrameBuffer *frame);
+
+    FramePoolStats const &Stats() const { return stats_; }
+
+  private:
+    FrameBuffer *Grow();
+
+    uint32_t width_, height_;
+    size_t rowPitch_;
+    std::vector<FrameBuffer *> all_, free_;
+    FramePoolStats stats_;
+};
+
+// Scoped hold on a pooled frame, returned to the pool on destruction.
+struct FrameLease {
+    FrameLease(FramePool &pool) : pool_(pool), frame_(pool.Acquire()) {}
+    ~FrameLease() { pool_.Release(frame_); }
+
+    FrameLease(FrameLease const &) = delete;
+    FrameLease &operator=(FrameLease const &) = delete;
+
+    FrameBuffer &operator*() const { return *frame_; }
+    FrameBuffer *operator->() const { return frame_; }
+
+  private:
+    FramePool &pool_;
+    FrameBuffer *frame_;
+};
+
+// Bump allocator for transient per-frame data. Allocations past the current capacity spill into extra blocks which
+// are folded into one larger block on the next Reset, so the arena converges on the high-water mark.
+struct FrameArena {
+    explicit FrameArena(size_t capacity = 0);
+    ~FrameArena();
+
+    FrameArena(FrameArena const &) = delete;
+    FrameArena &operator=(FrameArena const &) = delete;
+
+    void *Allocate(size_t size, size_t alignment = eFrameAlignment);
+
+    template <typename T> T *Allocate(size_t count) {
+        return static_cast<T *>(Allocate(sizeof(T) * count, (std::max)(alignof(T), size_t{eFrameAlignment})));
+    }
+
+    void Reset();
+
+    FramePoolStats const &Stats() const { return stats_; }
+
+  private:
+    struct Block {
+        uint8_t *base;
+        size_t size;
+    };
+
+    Block NewBlock(size_t size);
+
+    Block head_{};
+    size_t used_{};
+    std::vector<Block> spill_;
+    size_t spillUsed_{};
+    FramePoolStats stats_;
+};
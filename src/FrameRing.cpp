@@ -0,0 +1,196 @@
+#include "FrameRing.hpp"
+
+#include <fmt/format.h>
+#include <fmt/xchar.h>
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+namespace {
+uint64_t AlignUp(uint64_t bytes) { return (bytes + eFrameAlignment - 1) / eFrameAlignment * eFrameAlignment; }
+
+std::atomic_ref<uint64_t> Atomic(uint64_t const &value) { return std::atomic_ref(const_cast<uint64_t &>(value)); }
+
+FrameRingHeader &HeaderOf(uint8_t *view) { return *(FrameRingHeader *)view; }
+
+FrameRingSlot &SlotOf(uint8_t *view, FrameRingHeader const &layout, uint64_t frame) {
+    return *(FrameRingSlot *)(view + sizeof(FrameRingHeader) + frame % layout.slotCount * layout.slotStride);
+}
+
+// The producer's own slot, from the header it wrote.
+FrameRingSlot &SlotOf(uint8_t *view, uint64_t frame) { return SlotOf(view, HeaderOf(view), frame); }
+
+FrameBuffer PixelsOf(FrameRingHeader const &header, FrameRingSlot &slot) {
+    return {.width = header.width,
+            .height = header.height,
+            .rowPitch = header.rowPitch,
+            .pixels = (uint8_t *)&slot + sizeof(FrameRingSlot)};
+}
+} // namespace
+
+std::unique_ptr<FrameRing> FrameRing::Create(std::wstring const &name, uint32_t width, uint32_t height,
+                                             uint32_t slotCount) {
+    uint32_t rowPitch = 4 * width;
+    uint64_t slotStride = sizeof(FrameRingSlot) + AlignUp((uint64_t)rowPitch * height);
+    uint64_t size = sizeof(FrameRingHeader) + slotCount * slotStride;
+
+    // A second producer would interleave its frames with ours under the same sequence numbers.
+    std::unique_ptr<FrameRing> ret(new FrameRing);
+    ret->producer_ = CreateMutexW(nullptr, FALSE, (name + L"-producer").c_str());
+    if (!ret->producer_) {
+        fmt::print(L"Frame ring {} producer lock could not be created: {}\n", name, GetLastError());
+        return nullptr;
+    }
+    // An abandoned lock is one whose producer died; its ring is ours to continue.
+    DWORD wait = WaitForSingleObject(ret->producer_, 0);
+    if (wait != WAIT_OBJECT_0 && wait != WAIT_ABANDONED) {
+        CloseHandle(ret->producer_);
+        ret->producer_ = nullptr;
+        fmt::print(L"Frame ring {} already has a producer.\n", name);
+        return nullptr;
+    }
+
+    ret->mapping_ = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, (DWORD)(size >> 32),
+                                       (DWORD)size, name.c_str());
+    bool existed = GetLastError() == ERROR_ALREADY_EXISTS;
+    if (!ret->mapping_) {
+        fmt::print(L"Frame ring {} could not be created: {}\n", name, GetLastError());
+        return nullptr;
+    }
+    ret->view_ = (uint8_t *)MapViewOfFile(ret->mapping_, FILE_MAP_WRITE, 0, 0, size);
+    if (!ret->view_) {
+        fmt::print(L"Frame ring {} could not be mapped: {}\n", name, GetLastError());
+        return nullptr;
+    }
+
+    auto &header = HeaderOf(ret->view_);
+    if (existed) {
+        if (header.magic != FrameRingHeader::eMagic || header.version != FrameRingHeader::eVersion ||
+            header.width != width || header.height != height || header.rowPitch != rowPitch ||
+            header.slotCount != slotCount || header.slotStride != slotStride) {
+            fmt::print(L"Frame ring {} is still open with a different layout.\n", name);
+            return nullptr;
+        }
+        ret->next_ = Atomic(header.published).load(std::memory_order_acquire);
+        return ret;
+    }
+    header = FrameRingHeader{
+        .version = FrameRingHeader::eVersion,
+        .width = width,
+        .height = height,
+        .rowPitch = rowPitch,
+        .slotCount = slotCount,
+        .slotStride = slotStride,
+    };
+    std::atomic_ref(header.magic).store(FrameRingHeader::eMagic, std::memory_order_release);
+    return ret;
+}
+
+FrameRing::~FrameRing() {
+    if (view_) {
+        UnmapViewOfFile(view_);
+    }
+    if (mapping_) {
+        CloseHandle(mapping_);
+    }
+    if (producer_) {
+        ReleaseMutex(producer_);
+        CloseHandle(producer_);
+    }
+}
+
+FrameBuffer FrameRing::Begin(int combo, int frameIdx, double time) {
+    auto &slot = SlotOf(view_, next_);
+    Atomic(slot.sequence).store(2 * next_ + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.combo = combo;
+    slot.frameIdx = frameIdx;
+    slot.time = time;
+    return PixelsOf(HeaderOf(view_), slot);
+}
+
+void FrameRing::Publish() {
+    Atomic(SlotOf(view_, next_).sequence).store(2 * next_ + 2, std::memory_order_release);
+    ++next_;
+    Atomic(HeaderOf(view_).published).store(next_, std::memory_order_release);
+}
+
+void FrameRing::Discard() { Atomic(SlotOf(view_, next_).sequence).store(0, std::memory_order_release); }
+
+std::unique_ptr<FrameRingReader> FrameRingReader::Open(std::wstring const &name) {
+    std::unique_ptr<FrameRingReader> ret(new FrameRingReader);
+    ret->mapping_ = OpenFileMappingW(FILE_MAP_READ, FALSE, name.c_str());
+    if (ret->mapping_) {
+        ret->view_ = (uint8_t *)MapViewOfFile(ret->mapping_, FILE_MAP_READ, 0, 0, 0);
+    }
+    if (!ret->view_) {
+        fmt::print(L"Frame ring {} could not be opened: {}\n", name, GetLastError());
+        return nullptr;
+    }
+    auto &shared = HeaderOf(ret->view_);
+    if (std::atomic_ref(shared.magic).load(std::memory_order_acquire) != FrameRingHeader::eMagic ||
+        shared.version != FrameRingHeader::eVersion) {
+        fmt::print(L"Frame ring {} is not ready or has an unknown version.\n", name);
+        return nullptr;
+    }
+    // The header comes from another process; its slots have to fit the mapping before any of them is indexed, and
+    // only the copy checked here is used for indexing.
+    auto header = HeaderOf(ret->view_);
+    MEMORY_BASIC_INFORMATION info{};
+    if (!VirtualQuery(ret->view_, &info, sizeof(info))) {
+        fmt::print(L"Frame ring {} could not be queried: {}\n", name, GetLastError());
+        return nullptr;
+    }
+    if (info.RegionSize < sizeof(FrameRingHeader) || header.slotCount == 0 ||
+        header.rowPitch < 4 * (uint64_t)header.width ||
+        header.slotStride < sizeof(FrameRingSlot) + (uint64_t)header.rowPitch * header.height ||
+        header.slotStride > (info.RegionSize - sizeof(FrameRingHeader)) / header.slotCount) {
+        fmt::print(L"Frame ring {} describes {} slots of {} bytes that do not fit its {} byte mapping.\n", name,
+                   header.slotCount, header.slotStride, info.RegionSize);
+        return nullptr;
+    }
+    ret->layout_ = header;
+    return ret;
+}
+
+FrameRingReader::~FrameRingReader() {
+    if (view_) {
+        UnmapViewOfFile(view_);
+    }
+    if (mapping_) {
+        CloseHandle(mapping_);
+    }
+}
+
+uint64_t FrameRingReader::Published() const {
+    return Atomic(HeaderOf(view_).published).load(std::memory_order_acquire);
+}
+
+std::optional<FrameRingReader::Frame> FrameRingReader::Latest() const {
+    for (;;) {
+        uint64_t published = Published();
+        if (published == 0) {
+            return std::nullopt;
+        }
+        auto &slot = SlotOf(view_, layout_, published - 1);
+        uint64_t sequence = Atomic(slot.sequence).load(std::memory_order_acquire);
+        Frame ret{
+            .pixels = PixelsOf(layout_, slot),
+            .combo = slot.combo,
+            .frameIdx = slot.frameIdx,
+            .time = slot.time,
+            .sequence = sequence,
+        };
+        if (sequence == 2 * published && StillValid(ret)) {
+            return ret;
+        }
+        std::this_thread::yield();
+    }
+}
+
+bool FrameRingReader::StillValid(Frame const &frame) const {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    auto &slot = *(FrameRingSlot *)(frame.pixels.pixels - sizeof(FrameRingSlot));
+    return Atomic(slot.sequence).load(std::memory_order_relaxed) == frame.sequence;
+}
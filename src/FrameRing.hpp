@@ -0,0 +1,98 @@
+#pragma once
+
+#include "FramePool.hpp"
+
+#include <windows.h>
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+// Shared memory layout of a frame ring, for consumers in other processes. The mapping starts with the header,
+// followed by slotCount slots of slotStride bytes, each a FrameRingSlot and then its pixels from the next 64-byte
+// boundary. Frame n of the ring is written to slot n % slotCount.
+//
+// Slots are guarded by a sequence lock: sequence is 2n+1 while frame n is being written and 2n+2 once it is
+// published. A reader loads the sequence, uses the pixels in place, then loads it again; the frame was intact if both
+// loads read the same even value.
+struct FrameRingHeader {
+    enum : uint32_t { eMagic = 0x52584644 /* "DFXR" */, eVersion = 1 };
+
+    uint32_t magic; // written last, readers wait for it
+    uint32_t version;
+    uint32_t width, height;
+    uint32_t rowPitch;
+    uint32_t slotCount;
+    uint64_t slotStride;
+    uint64_t published; // frames published so far
+    uint8_t pad[24];
+};
+
+struct FrameRingSlot {
+    uint64_t sequence;
+    int32_t combo;    // index into the catalog's combos
+    int32_t frameIdx; // frame of the loop
+    double time;      // loop time the frame was rendered at
+    uint8_t pad[40];
+};
+
+static_assert(sizeof(FrameRingHeader) == eFrameAlignment && sizeof(FrameRingSlot) == eFrameAlignment);
+
+// Producer side of a named shared memory ring of 32bpp frames. Frames are rendered straight into the mapped slots and
+// published without copies or locks; any number of readers may map the ring and never block the producer, which
+// overwrites the oldest slot when they fall behind.
+struct FrameRing {
+    // Creates the mapping, or reuses one with the same frame size and slot count that readers kept open from an
+    // earlier run, continuing its sequence. Fails while another producer has the ring; the one returned holds the
+    // named mutex "<name>-producer" until it is destroyed, which has to happen on the creating thread.
+    static std::unique_ptr<FrameRing> Create(std::wstring const &name, uint32_t width, uint32_t height,
+                                             uint32_t slotCount);
+    ~FrameRing();
+
+    FrameRing(FrameRing const &) = delete;
+    FrameRing &operator=(FrameRing const &) = delete;
+
+    // Claims the next slot, marking it as being written, and returns a frame over its pixels.
+    FrameBuffer Begin(int combo, int frameIdx, double time);
+    // Publishes the frame written since Begin.
+    void Publish();
+    // Abandons the frame written since Begin; its slot stays empty and the next Begin reuses the sequence number.
+    void Discard();
+
+  private:
+    FrameRing() = default;
+
+    HANDLE producer_{}, mapping_{};
+    uint8_t *view_{};
+    uint64_t next_{};
+};
+
+// Read-only view of a frame ring published by another process.
+struct FrameRingReader {
+    struct Frame {
+        FrameBuffer pixels; // in the shared mapping, valid to read until the producer reuses the slot
+        int combo, frameIdx;
+        double time;
+        uint64_t sequence;
+    };
+
+    static std::unique_ptr<FrameRingReader> Open(std::wstring const &name);
+    ~FrameRingReader();
+
+    FrameRingReader(FrameRingReader const &) = delete;
+    FrameRingReader &operator=(FrameRingReader const &) = delete;
+
+    uint64_t Published() const;
+    // Newest published frame, if any; retries while the producer is mid-write on it.
+    std::optional<Frame> Latest() const;
+    // Whether the frame's pixels were left untouched since Latest returned it; check after using them.
+    bool StillValid(Frame const &frame) const;
+
+  private:
+    FrameRingReader() = default;
+
+    HANDLE mapping_{};
+    uint8_t *view_{};
+    FrameRingHeader layout_{}; // validated against the mapping's size at Open
+};
@@ -0,0 +1,469 @@
+#include "ImageCodec.hpp"
+
+#include <fmt/format.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+std::string_view Extension(ImageFormat format) {
+    switch (format) {
+    case ImageFormat::Png:
+    case ImageFormat::Apng:
+        return "png";
+    case ImageFormat::Qoi:
+        return "qoi";
+    }
+    return "";
+}
+
+namespace {
+void PutU32(std::vector<uint8_t> &out, uint32_t value) {
+    uint8_t bytes[]{uint8_t(value >> 24), uint8_t(value >> 16), uint8_t(value >> 8), uint8_t(value)};
+    out.insert(out.end(), std::begin(bytes), std::end(bytes));
+}
+
+void PutPngChunk(std::vector<uint8_t> &out, char const (&type)[5], uint8_t const *data, size_t size) {
+    PutU32(out, (uint32_t)size);
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + size);
+    PutU32(out, crc32(0, out.data() + start, (uInt)(out.size() - start)));
+}
+
+enum PngFilter : uint8_t { eFilterNone, eFilterSub, eFilterUp, eFilterAverage, eFilterPaeth, eFilterCount };
+
+// Sum of the residuals read as signed bytes, the usual estimate of how well a filtered row compresses. The loops are
+// plain byte arithmetic over whole rows so the compiler can vectorize them.
+uint32_t ResidualCost(uint8_t const *row, size_t size) {
+    uint32_t cost = 0;
+    for (size_t i = 0; i < size; ++i) {
+        cost += (uint32_t)std::abs((int)(int8_t)row[i]);
+    }
+    return cost;
+}
+
+void FilterRow(PngFilter filter, uint8_t const *cur, uint8_t const *prev, size_t size, uint8_t *out) {
+    constexpr size_t bpp = 4;
+    switch (filter) {
+    case eFilterNone:
+        memcpy(out, cur, size);
+        break;
+    case eFilterSub:
+        memcpy(out, cur, bpp);
+        for (size_t i = bpp; i < size; ++i) {
+            out[i] = uint8_t(cur[i] - cur[i - bpp]);
+        }
+        break;
+    case eFilterUp:
+        for (size_t i = 0; i < size; ++i) {
+            out[i] = uint8_t(cur[i] - prev[i]);
+        }
+        break;
+    case eFilterAverage:
+        for (size_t i = 0; i < bpp; ++i) {
+            out[i] = uint8_t(cur[i] - (prev[i] >> 1));
+        }
+        for (size_t i = bpp; i < size; ++i) {
+            out[i] = uint8_t(cur[i] - ((cur[i - bpp] + prev[i]) >> 1));
+        }
+        break;
+    case eFilterPaeth:
+        for (size_t i = 0; i < bpp; ++i) {
+            out[i] = uint8_t(cur[i] - prev[i]);
+        }
+        for (size_t i = bpp; i < size; ++i) {
+            int a = cur[i - bpp], b = prev[i], c = prev[i - bpp];
+            int pa = std::abs(b - c), pb = std::abs(a - c), pc = std::abs(a + b - 2 * c);
+            int pred = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+            out[i] = uint8_t(cur[i] - pred);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+// Filters rows [rowBegin, rowEnd) into out, one filter byte followed by the residuals per row. candidate holds a row
+// and zeroRow is a row of zeros standing in above the first.
+void FilterRows(FrameBuffer const &frame, PixelRect rect, int rowBegin, int rowEnd, uint8_t *out, uint8_t *candidate,
+                uint8_t const *zeroRow) {
+    size_t rowBytes = 4 * (size_t)rect.width;
+    for (int y = rowBegin; y < rowEnd; ++y) {
+        uint8_t const *cur = frame.Pixel(rect.x, rect.y + y);
+        uint8_t const *prev = y ? frame.Pixel(rect.x, rect.y + y - 1) : zeroRow;
+        uint8_t *dst = out + (y - rowBegin) * (rowBytes + 1);
+        uint32_t bestCost = UINT32_MAX;
+        for (uint8_t filter = eFilterNone; filter < eFilterCount; ++filter) {
+            FilterRow((PngFilter)filter, cur, prev, rowBytes, candidate);
+            uint32_t cost = ResidualCost(candidate, rowBytes);
+            if (cost < bestCost) {
+                bestCost = cost;
+                dst[0] = filter;
+                memcpy(dst + 1, candidate, rowBytes);
+            }
+        }
+    }
+}
+
+// Signature, IHDR and sRGB of an RGBA8 image.
+void PutPngHeader(std::vector<uint8_t> &out, int width, int height) {
+    out.insert(out.end(), {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'});
+    uint8_t ihdr[13]{};
+    for (int i = 0; i < 4; ++i) {
+        ihdr[i] = uint8_t((uint32_t)width >> (24 - 8 * i));
+        ihdr[4 + i] = uint8_t((uint32_t)height >> (24 - 8 * i));
+    }
+    ihdr[8] = 8; // 8-bit RGBA, deflate, adaptive filtering, no interlace
+    ihdr[9] = 6;
+    PutPngChunk(out, "IHDR", ihdr, sizeof(ihdr));
+    uint8_t srgbIntent = 0; // perceptual
+    PutPngChunk(out, "sRGB", &srgbIntent, 1);
+}
+} // namespace
+
+// One deflate chunk's stream and buffers, kept from frame to frame.
+struct PngEncoder::Chunk {
+    z_stream zs{};
+    int initResult = Z_STREAM_ERROR;
+    std::vector<uint8_t> compressed, candidate;
+    size_t compressedSize{}, inputSize{};
+    uLong adler{};
+    bool ok{};
+
+    ~Chunk() {
+        if (initResult == Z_OK) {
+            deflateEnd(&zs);
+        }
+    }
+
+    // Raw deflate of [begin, end) of data. Non-final chunks end in a sync flush so they stop on a byte boundary with
+    // no final block and can be concatenated; the 32 KiB before the chunk primes the window so matches across the
+    // seam are kept.
+    bool Deflate(uint8_t const *data, size_t begin, size_t end, bool last, int level) {
+        if (initResult != Z_OK) {
+            initResult = deflateInit2(&zs, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+            if (initResult != Z_OK) {
+                return false;
+            }
+        } else if (deflateReset(&zs) != Z_OK) {
+            return false;
+        }
+        inputSize = end - begin;
+        adler = adler32(adler32(0, nullptr, 0), data + begin, (uInt)inputSize);
+        if (begin > 0) {
+            size_t dictSize = (std::min)(begin, size_t(32768));
+            if (deflateSetDictionary(&zs, data + begin - dictSize, (uInt)dictSize) != Z_OK) {
+                return false;
+            }
+        }
+        // The bound covers a finished stream; a sync flush adds at most an empty stored block to the data.
+        size_t bound = deflateBound(&zs, (uLong)inputSize) + 8;
+        if (compressed.size() < bound) {
+            compressed.resize(bound);
+        }
+        zs.next_in = const_cast<Bytef *>(data + begin);
+        zs.avail_in = (uInt)inputSize;
+        zs.next_out = compressed.data();
+        zs.avail_out = (uInt)compressed.size();
+        int result = deflate(&zs, last ? Z_FINISH : Z_SYNC_FLUSH);
+        compressedSize = compressed.size() - zs.avail_out;
+        return last ? result == Z_STREAM_END : result == Z_OK && zs.avail_in == 0 && zs.avail_out > 0;
+    }
+};
+
+PngEncoder::PngEncoder(PngSettings settings)
+    : settings_(settings),
+      threads_(settings.threads ? settings.threads : (std::max)(std::thread::hardware_concurrency(), 1u)) {}
+
+PngEncoder::~PngEncoder() {
+    {
+        std::lock_guard lock(mutex_);
+        quit_ = true;
+    }
+    wake_.notify_all();
+    for (auto &worker : workers_) {
+        worker.join();
+    }
+}
+
+void PngEncoder::Work() {
+    std::unique_lock lock(mutex_);
+    while (true) {
+        wake_.wait(lock, [&] { return quit_ || nextChunk_ < jobChunks_; });
+        if (quit_) {
+            return;
+        }
+        int chunk = nextChunk_++;
+        auto &fn = *job_;
+        lock.unlock();
+        fn(chunk);
+        lock.lock();
+        if (++finishedChunks_ == jobChunks_) {
+            done_.notify_one();
+        }
+    }
+}
+
+void PngEncoder::RunChunks(int count, std::function<void(int)> const &fn) {
+    if (workers_.empty()) {
+        for (unsigned i = 1; i < threads_; ++i) {
+            workers_.emplace_back([this] { Work(); });
+        }
+    }
+    std::unique_lock lock(mutex_);
+    job_ = &fn;
+    jobChunks_ = count;
+    nextChunk_ = 0;
+    finishedChunks_ = 0;
+    wake_.notify_all();
+    // The calling thread takes chunks too rather than idling until the workers are done.
+    while (nextChunk_ < jobChunks_) {
+        int chunk = nextChunk_++;
+        lock.unlock();
+        fn(chunk);
+        lock.lock();
+        ++finishedChunks_;
+    }
+    done_.wait(lock, [&] { return finishedChunks_ == jobChunks_; });
+    job_ = nullptr;
+    jobChunks_ = 0;
+}
+
+bool PngEncoder::Compress(FrameBuffer const &frame, PixelRect rect, std::vector<uint8_t> &out) {
+    size_t rowBytes = 4 * (size_t)rect.width;
+    size_t filteredRow = rowBytes + 1;
+    filtered_.resize(filteredRow * rect.height);
+    zeroRow_.resize(rowBytes);
+
+    // Chunks of at least 16 rows, so tiny region crops are not split into more work than they are worth.
+    int chunkCount = std::clamp((int)threads_, 1, (std::max)(rect.height / 16, 1));
+    while (chunks_.size() < (size_t)chunkCount) {
+        chunks_.push_back(std::make_unique<Chunk>());
+    }
+    auto chunkRow = [&](int chunk) { return rect.height * chunk / chunkCount; };
+    int level = std::clamp(settings_.level, 0, 9);
+    RunChunks(chunkCount, [&](int chunkIdx) {
+        auto &chunk = *chunks_[chunkIdx];
+        chunk.candidate.resize(rowBytes);
+        FilterRows(frame, rect, chunkRow(chunkIdx), chunkRow(chunkIdx + 1),
+                   filtered_.data() + chunkRow(chunkIdx) * filteredRow, chunk.candidate.data(), zeroRow_.data());
+    });
+    RunChunks(chunkCount, [&](int chunkIdx) {
+        auto &chunk = *chunks_[chunkIdx];
+        chunk.ok = chunk.Deflate(filtered_.data(), chunkRow(chunkIdx) * filteredRow,
+                                 chunkRow(chunkIdx + 1) * filteredRow, chunkIdx + 1 == chunkCount, level);
+    });
+
+    out.insert(out.end(), {0x78, 0x9C});
+    uLong adler = adler32(0, nullptr, 0);
+    for (int chunkIdx = 0; chunkIdx < chunkCount; ++chunkIdx) {
+        auto &chunk = *chunks_[chunkIdx];
+        if (!chunk.ok) {
+            fmt::print("PNG deflate failed on rows {}-{} of a {}x{} image.\n", chunkRow(chunkIdx),
+                       chunkRow(chunkIdx + 1), rect.width, rect.height);
+            return false;
+        }
+        out.insert(out.end(), chunk.compressed.begin(), chunk.compressed.begin() + chunk.compressedSize);
+        adler = adler32_combine(adler, chunk.adler, (z_off_t)chunk.inputSize);
+    }
+    PutU32(out, (uint32_t)adler);
+    return true;
+}
+
+bool PngEncoder::Encode(FrameBuffer const &frame, PixelRect rect, std::vector<uint8_t> &out) {
+    out.clear();
+    PutPngHeader(out, rect.width, rect.height);
+    data_.clear();
+    if (!Compress(frame, rect, data_)) {
+        return false;
+    }
+    PutPngChunk(out, "IDAT", data_.data(), data_.size());
+    PutPngChunk(out, "IEND", nullptr, 0);
+    return true;
+}
+
+ApngWriter::ApngWriter(std::filesystem::path path, int width, int height, int fps, PngEncoder &encoder)
+    : path_(std::move(path)), width_(width), height_(height), fps_(fps), encoder_(encoder) {
+    PutPngHeader(out_, width, height);
+    actlOffset_ = out_.size();
+    uint8_t actl[8]{}; // frame count filled in by Finish, zero plays loops forever
+    PutPngChunk(out_, "acTL", actl, sizeof(actl));
+    previous_.resize(4 * (size_t)width * height);
+}
+
+PixelRect ApngWriter::ChangedRect(FrameBuffer const &frame) const {
+    int top = height_, bottom = -1, left = width_, right = -1;
+    size_t rowBytes = 4 * (size_t)width_;
+    for (int y = 0; y < height_; ++y) {
+        auto *cur = (uint32_t const *)frame.Pixel(0, y);
+        auto *prev = (uint32_t const *)(previous_.data() + y * rowBytes);
+        if (memcmp(cur, prev, rowBytes) == 0) {
+            continue;
+        }
+        top = (std::min)(top, y);
+        bottom = y;
+        int x0 = 0, x1 = width_ - 1;
+        while (cur[x0] == prev[x0]) {
+            ++x0;
+        }
+        while (cur[x1] == prev[x1]) {
+            --x1;
+        }
+        left = (std::min)(left, x0);
+        right = (std::max)(right, x1);
+    }
+    if (bottom < 0) {
+        return {};
+    }
+    return {left, top, right - left + 1, bottom - top + 1};
+}
+
+void ApngWriter::AddFrame(FrameBuffer const &frame) {
+    PixelRect rect{0, 0, width_, height_};
+    if (frameCount_ > 0) {
+        rect = ChangedRect(frame);
+        if (rect.Empty()) {
+            // Nothing moved, so the previous frame is simply shown for longer.
+            PatchDelay(delayOffset_, ++delayFrames_);
+            return;
+        }
+    }
+    for (int y = 0; y < height_; ++y) {
+        memcpy(previous_.data() + y * 4 * (size_t)width_, frame.Pixel(0, y), 4 * (size_t)width_);
+    }
+
+    // Only the changed rectangle is stored; it replaces that area of the canvas and the rest stays as it was.
+    std::vector<uint8_t> fctl;
+    PutU32(fctl, sequence_++);
+    PutU32(fctl, rect.width);
+    PutU32(fctl, rect.height);
+    PutU32(fctl, rect.x);
+    PutU32(fctl, rect.y);
+    fctl.insert(fctl.end(), {0, 1, uint8_t(fps_ >> 8), uint8_t(fps_)}); // delay of 1/fps
+    fctl.insert(fctl.end(), {eApngDisposeNone, eApngBlendSource});
+    delayOffset_ = out_.size() + 8 + 20;
+    delayFrames_ = 1;
+    PutPngChunk(out_, "fcTL", fctl.data(), fctl.size());
+
+    // fdAT starts with its sequence number, IDAT is only the image data.
+    data_.clear();
+    if (frameCount_ > 0) {
+        PutU32(data_, sequence_++);
+    }
+    failed_ |= !encoder_.Compress(frame, rect, data_);
+    PutPngChunk(out_, frameCount_ == 0 ? "IDAT" : "fdAT", data_.data(), data_.size());
+    ++frameCount_;
+}
+
+void ApngWriter::PatchDelay(size_t offset, uint16_t frames) {
+    out_[offset] = uint8_t(frames >> 8);
+    out_[offset + 1] = uint8_t(frames);
+    RecomputeCrc(offset - 8 - 20);
+}
+
+void ApngWriter::RecomputeCrc(size_t chunkOffset) {
+    uint32_t size = uint32_t(out_[chunkOffset]) << 24 | uint32_t(out_[chunkOffset + 1]) << 16 |
+                    uint32_t(out_[chunkOffset + 2]) << 8 | out_[chunkOffset + 3];
+    uint32_t crc = crc32(0, out_.data() + chunkOffset + 4, 4 + size);
+    uint8_t *dst = out_.data() + chunkOffset + 8 + size;
+    dst[0] = uint8_t(crc >> 24);
+    dst[1] = uint8_t(crc >> 16);
+    dst[2] = uint8_t(crc >> 8);
+    dst[3] = uint8_t(crc);
+}
+
+bool ApngWriter::Finish() {
+    uint8_t *numFrames = out_.data() + actlOffset_ + 8;
+    numFrames[0] = uint8_t(frameCount_ >> 24);
+    numFrames[1] = uint8_t(frameCount_ >> 16);
+    numFrames[2] = uint8_t(frameCount_ >> 8);
+    numFrames[3] = uint8_t(frameCount_);
+    RecomputeCrc(actlOffset_);
+    PutPngChunk(out_, "IEND", nullptr, 0);
+    if (failed_) {
+        fmt::print("Not writing {}, some of its frames failed to encode.\n", path_.string());
+        return false;
+    }
+    return WriteBinaryFile(path_, out_);
+}
+
+std::vector<uint8_t> EncodeQoi(FrameBuffer const &frame, PixelRect rect) {
+    enum : uint8_t {
+        eQoiIndex = 0x00,
+        eQoiDiff = 0x40,
+        eQoiLuma = 0x80,
+        eQoiRun = 0xC0,
+        eQoiRgb = 0xFE,
+        eQoiRgba = 0xFF,
+    };
+    std::vector<uint8_t> out{'q', 'o', 'i', 'f'};
+    out.reserve(14 + rect.Area() * 5 + 8);
+    PutU32(out, rect.width);
+    PutU32(out, rect.height);
+    out.push_back(4); // RGBA
+    out.push_back(0); // sRGB with linear alpha
+
+    struct Rgba {
+        uint8_t r, g, b, a;
+        bool operator==(Rgba const &) const = default;
+    };
+    Rgba seen[64]{};
+    Rgba prev{0, 0, 0, 255};
+    int run = 0;
+    for (int y = 0; y < rect.height; ++y) {
+        uint8_t const *row = frame.Pixel(rect.x, rect.y + y);
+        for (int x = 0; x < rect.width; ++x) {
+            Rgba px{row[4 * x], row[4 * x + 1], row[4 * x + 2], row[4 * x + 3]};
+            if (px == prev) {
+                if (++run == 62) {
+                    out.push_back(eQoiRun | (run - 1));
+                    run = 0;
+                }
+                continue;
+            }
+            if (run) {
+                out.push_back(eQoiRun | (run - 1));
+                run = 0;
+            }
+            int hash = (px.r * 3 + px.g * 5 + px.b * 7 + px.a * 11) % 64;
+            if (seen[hash] == px) {
+                out.push_back(eQoiIndex | hash);
+            } else {
+                seen[hash] = px;
+                if (px.a == prev.a) {
+                    int8_t dr = int8_t(px.r - prev.r), dg = int8_t(px.g - prev.g), db = int8_t(px.b - prev.b);
+                    int8_t drg = int8_t(dr - dg), dbg = int8_t(db - dg);
+                    if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                        out.push_back(eQoiDiff | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+                    } else if (dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 && dbg >= -8 && dbg <= 7) {
+                        out.push_back(eQoiLuma | (dg + 32));
+                        out.push_back((drg + 8) << 4 | (dbg + 8));
+                    } else {
+                        out.insert(out.end(), {eQoiRgb, px.r, px.g, px.b});
+                    }
+                } else {
+                    out.insert(out.end(), {eQoiRgba, px.r, px.g, px.b, px.a});
+                }
+            }
+            prev = px;
+        }
+    }
+    if (run) {
+        out.push_back(eQoiRun | (run - 1));
+    }
+    out.insert(out.end(), {0, 0, 0, 0, 0, 0, 0, 1});
+    return out;
+}
+
+bool WriteBinaryFile(std::filesystem::path const &path, std::vector<uint8_t> const &data) {
+    std::ofstream fh(path, std::ios::binary);
+    fh.write((char const *)data.data(), data.size());
+    if (!fh) {
+        fmt::print("Could not write {}\n", path.string());
+        return false;
+    }
+    return true;
+}
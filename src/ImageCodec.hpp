@@ -0,0 +1,94 @@
+#pragma once
+
+#include "FramePool.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+enum class ImageFormat {
+    Png, // final output
+    Qoi,  // fast lossless intermediate for frames that are re-encoded later
+    Apng, // one looping animated PNG per sequence
+};
+
+std::string_view Extension(ImageFormat format);
+
+struct PngSettings {
+    int level = 6;        // zlib compression level, 0 stores, 9 is smallest
+    unsigned threads = 0; // deflate chunks compressed in parallel, 0 for one per core
+};
+
+// Encodes RGBA8 sRGB frames as PNG. Each row gets the filter with the smallest sum of absolute residuals, and the
+// filtered rows are deflated in independent chunks and joined into one zlib stream. The chunks run on worker threads
+// that persist from frame to frame, and the filter and deflate buffers are reused once they have grown. Encodes one
+// frame at a time.
+struct PngEncoder {
+    explicit PngEncoder(PngSettings settings = {});
+    ~PngEncoder();
+
+    PngEncoder(PngEncoder const &) = delete;
+    PngEncoder &operator=(PngEncoder const &) = delete;
+
+    // Replaces out with a PNG of a rectangle of the frame; false if deflate failed.
+    bool Encode(FrameBuffer const &frame, PixelRect rect, std::vector<uint8_t> &out);
+    // Appends the filtered and deflated image data of a rectangle, the payload of IDAT or fdAT; false if deflate
+    // failed, leaving out partly written.
+    bool Compress(FrameBuffer const &frame, PixelRect rect, std::vector<uint8_t> &out);
+
+  private:
+    struct Chunk;
+
+    // Runs fn on chunks [0, count) across the workers and the calling thread, returning once all have finished.
+    void RunChunks(int count, std::function<void(int)> const &fn);
+    void Work();
+
+    PngSettings settings_;
+    unsigned threads_;
+    std::vector<std::unique_ptr<Chunk>> chunks_;
+    std::vector<uint8_t> filtered_, zeroRow_, data_;
+
+    std::vector<std::thread> workers_; // started with the first frame
+    std::mutex mutex_;
+    std::condition_variable wake_, done_;
+    std::function<void(int)> const *job_{};
+    int jobChunks_{}, nextChunk_{}, finishedChunks_{};
+    bool quit_{};
+};
+
+// Encodes a rectangle of an RGBA8 frame as QOI, see https://qoiformat.org/qoi-specification.pdf.
+std::vector<uint8_t> EncodeQoi(FrameBuffer const &frame, PixelRect rect);
+
+// Encodes a loop as one animated PNG that repeats forever. The first frame is stored whole; every later frame stores
+// only the rectangle that changed since the frame before, and unchanged frames extend the previous frame's delay.
+struct ApngWriter {
+    ApngWriter(std::filesystem::path path, int width, int height, int fps, PngEncoder &encoder);
+
+    void AddFrame(FrameBuffer const &frame);
+    // Writes the file; false if it or any frame failed.
+    bool Finish();
+
+  private:
+    enum : uint8_t { eApngDisposeNone = 0, eApngBlendSource = 0 };
+
+    PixelRect ChangedRect(FrameBuffer const &frame) const;
+    void PatchDelay(size_t offset, uint16_t frames);
+    void RecomputeCrc(size_t chunkOffset);
+
+    std::filesystem::path path_;
+    int width_, height_, fps_;
+    PngEncoder &encoder_;
+    std::vector<uint8_t> out_, previous_, data_;
+    size_t actlOffset_{}, delayOffset_{};
+    uint16_t delayFrames_{};
+    uint32_t sequence_{}, frameCount_{};
+    bool failed_{};
+};
+
+bool WriteBinaryFile(std::filesystem::path const &path, std::vector<uint8_t> const &data);
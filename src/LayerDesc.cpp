@@ -0,0 +1,204 @@
+#include "LayerDesc.hpp"
+#include "D3D.hpp"
+#include "Util.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <sstream>
+
+float LayerParamDesc::Float(int component) const { return std::bit_cast<float>(bits[component]); }
+
+ShaderSpecialization LayerDesc::Specialization() const {
+    ShaderSpecialization ret;
+    for (auto &param : params) {
+        if (!param.specialize || param.components != 1) {
+            continue;
+        }
+        if (param.isUint) {
+            ret.Uint(param.field, param.bits[0]);
+        } else {
+            ret.Float(param.field, param.Float());
+        }
+    }
+    // Solid textures sample as their color at every mip and unbound ones as zero. Border addressing would still see
+    // the border color on a real texture, which none of the solid bindings rely on.
+    for (auto &texture : textures) {
+        if (texture.solid) {
+            auto channel = [&](int shift) { return ((texture.color >> shift) & 0xFF) / 255.0f; };
+            ret.Texture(texture.name, {channel(16), channel(8), channel(0), channel(24)});
+        } else if (texture.path.empty()) {
+            ret.Texture(texture.name, {});
+        }
+    }
+    return ret;
+}
+
+LayerParamDesc const *LayerDesc::FindParam(std::string_view field) const {
+    for (auto &param : params) {
+        if (param.field == field) {
+            return &param;
+        }
+    }
+    return nullptr;
+}
+
+float LayerDesc::MinUvScale() const {
+    float ret = 1.0f;
+    auto *texScale = FindParam("tex_scale");
+    auto *aspectRatio = FindParam("aspect_ratio");
+    for (int i = 0; i < 2; ++i) {
+        // Either may multiply or divide the coordinates depending on the shader, so both directions count.
+        if (texScale && !texScale->isUint && i < texScale->components && texScale->Float(i) > 0.0f) {
+            ret = (std::min)({ret, texScale->Float(i), 1.0f / texScale->Float(i)});
+        }
+        if (aspectRatio && !aspectRatio->isUint && i < aspectRatio->components && aspectRatio->Float(i) > 0.0f) {
+            ret = (std::min)({ret, aspectRatio->Float(i), 1.0f / aspectRatio->Float(i)});
+        }
+    }
+    return ret;
+}
+
+std::optional<LayerParamDesc> ParseLayerParam(std::vector<std::string> const &tokens) {
+    // tokens: param|const <type> <field> <values...>
+    if (tokens.size() < 4) {
+        return std::nullopt;
+    }
+    LayerParamDesc ret{.field = tokens[2], .specialize = tokens[0] == "const"};
+    auto &type = tokens[1];
+    if (type == "uint") {
+        ret.isUint = true;
+    } else if (type == "float") {
+        ret.components = 1;
+    } else if (type.size() == 6 && type.starts_with("float") && type[5] >= '2' && type[5] <= '4') {
+        ret.components = type[5] - '0';
+    } else {
+        return std::nullopt;
+    }
+    if (tokens.size() - 3 != (size_t)ret.components) {
+        return std::nullopt;
+    }
+    for (int i = 0; i < ret.components; ++i) {
+        auto &text = tokens[3 + i];
+        std::from_chars_result res;
+        if (ret.isUint) {
+            res = std::from_chars(text.data(), text.data() + text.size(), ret.bits[i]);
+        } else {
+            float value{};
+            res = std::from_chars(text.data(), text.data() + text.size(), value);
+            ret.bits[i] = std::bit_cast<uint32_t>(value);
+        }
+        if (res.ec != std::errc{} || res.ptr != text.data() + text.size()) {
+            return std::nullopt;
+        }
+    }
+    return ret;
+}
+
+namespace {
+std::optional<LayerTextureDesc> ParseTexture(std::vector<std::string> const &tokens) {
+    if (tokens[0] == "texture" && (tokens.size() == 3 || (tokens.size() == 4 && tokens[3] == "srgb"))) {
+        return LayerTextureDesc{
+            .name = tokens[1],
+            .path = tokens[2] == "-" ? std::string{} : tokens[2],
+            .srgb = tokens.size() == 4,
+        };
+    }
+    if (tokens[0] == "solid" && tokens.size() == 5) {
+        LayerTextureDesc ret{.name = tokens[1], .solid = true};
+        auto parse = [](std::string const &text, auto &out, int base) {
+            auto res = std::from_chars(text.data(), text.data() + text.size(), out, base);
+            return res.ec == std::errc{} && res.ptr == text.data() + text.size();
+        };
+        if (parse(tokens[2], ret.width, 10) && parse(tokens[3], ret.height, 10) && parse(tokens[4], ret.color, 16) &&
+            ret.width > 0 && ret.height > 0) {
+            return ret;
+        }
+    }
+    return std::nullopt;
+}
+} // namespace
+
+std::optional<LayerCatalog> LoadLayerCatalog(std::filesystem::path const &path) {
+    if (!exists(path)) {
+        fmt::print("Layer description {} not found.\n", path.string());
+        return std::nullopt;
+    }
+    LayerCatalog ret;
+    std::istringstream is(SlurpTextFile(path));
+    std::string line;
+    bool inCombos = false;
+    int lineNo = 0;
+    auto fail = [&](std::string_view what) {
+        fmt::print("{}:{}: {}\n", path.string(), lineNo, what);
+        return std::nullopt;
+    };
+    while (std::getline(is, line)) {
+        ++lineNo;
+        if (auto hash = line.find('#'); hash != std::string::npos) {
+            line.resize(hash);
+        }
+        std::vector<std::string> tokens;
+        std::istringstream ls(line);
+        for (std::string token; ls >> token;) {
+            tokens.push_back(token);
+        }
+        if (tokens.empty()) {
+            continue;
+        }
+
+        if (tokens[0] == "[combos]") {
+            inCombos = true;
+        } else if (tokens[0] == "[layer" && tokens.size() == 2 && tokens[1].ends_with(']')) {
+            inCombos = false;
+            ret.layers.push_back(LayerDesc{.name = tokens[1].substr(0, tokens[1].size() - 1)});
+        } else if (inCombos && tokens[0] == "combo" && tokens.size() > 1) {
+            std::vector<int> combo;
+            for (size_t i = 1; i < tokens.size(); ++i) {
+                int layerIdx = -1;
+                std::from_chars(tokens[i].data(), tokens[i].data() + tokens[i].size(), layerIdx);
+                if (layerIdx < 0 || layerIdx >= (int)ret.layers.size()) {
+                    return fail(fmt::format("combo references unknown layer {}", tokens[i]));
+                }
+                combo.push_back(layerIdx);
+            }
+            ret.combos.push_back(combo);
+        } else if (inCombos || ret.layers.empty()) {
+            return fail(fmt::format("unexpected '{}'", tokens[0]));
+        } else if (auto &layer = ret.layers.back(); tokens[0] == "kind" && tokens.size() == 2) {
+            if (tokens[1] == "draw2d") {
+                layer.kind = LayerKind::Draw2D;
+            } else if (tokens[1] == "atlas") {
+                layer.kind = LayerKind::AtlasEffects;
+            } else {
+                return fail(fmt::format("unknown layer kind '{}'", tokens[1]));
+            }
+        } else if (tokens[0] == "shader" && tokens.size() == 3) {
+            layer.fragment = tokens[1];
+            layer.entrypoint = tokens[2];
+        } else if (tokens[0] == "param" || tokens[0] == "const") {
+            auto param = ParseLayerParam(tokens);
+            if (!param) {
+                return fail("malformed parameter");
+            }
+            layer.params.push_back(*param);
+        } else if (tokens[0] == "texture" || tokens[0] == "solid") {
+            auto texture = ParseTexture(tokens);
+            if (!texture) {
+                return fail("malformed texture");
+            }
+            layer.textures.push_back(*texture);
+        } else {
+            return fail(fmt::format("unexpected '{}'", tokens[0]));
+        }
+    }
+    for (auto &layer : ret.layers) {
+        if (layer.entrypoint.empty()) {
+            lineNo = 0;
+            return fail(fmt::format("layer {} has no shader", layer.name));
+        }
+    }
+    return ret;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+struct ShaderSpecialization;
+
+enum class LayerKind {
+    Draw2D,
+    AtlasEffects,
+};
+
+// Default value of a cbuffer field, already converted to the bits stored in the cbuffer.
+struct LayerParamDesc {
+    std::string field;
+    bool isUint{};
+    int components{1};
+    std::array<uint32_t, 4> bits{};
+    bool specialize{}; // also compiled into the shader variant
+
+    float Float(int component = 0) const;
+};
+
+struct LayerTextureDesc {
+    std::string name;
+    std::string path; // empty binds nothing unless solid
+    bool srgb{};
+    bool solid{};
+    int width{}, height{};
+    uint32_t color{};
+};
+
+struct LayerDesc {
+    std::string name;
+    LayerKind kind{};
+    std::string fragment, entrypoint;
+    std::vector<LayerParamDesc> params;
+    std::vector<LayerTextureDesc> textures;
+
+    ShaderSpecialization Specialization() const;
+    LayerParamDesc const *FindParam(std::string_view field) const;
+    // Smallest factor the layer's tex_scale and aspect_ratio scale texture coordinates by, 1 at most. Below 1 the
+    // layer magnifies its textures.
+    float MinUvScale() const;
+};
+
+// Every layer the tool knows how to draw and the combinations of them exported by the batch, loaded from a
+// description file so new influences and pairs need no rebuild. See data/layers.txt for the format.
+struct LayerCatalog {
+    std::vector<LayerDesc> layers;
+    std::vector<std::vector<int>> combos;
+};
+
+// Parses a "param|const <type> <field> <values...>" line split into tokens.
+std::optional<LayerParamDesc> ParseLayerParam(std::vector<std::string> const &tokens);
+
+std::optional<LayerCatalog> LoadLayerCatalog(std::filesystem::path const &path);
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <optional>
+
+// Time mapping of an exported loop. The last lerpFrames frames are blended towards the frames just before frame 0
+// so the animation wraps seamlessly; every frame only depends on its own index, which keeps any subset of frames
+// renderable in isolation.
+struct LoopTiming {
+    float baseTime = 0.0f;
+    int numFrames = 300;
+    float fps = 60.0f;
+    int lerpFrames = 60;
+
+    float TimeAt(int frame) const { return baseTime + (float)frame / fps; }
+
+    struct Crossfade {
+        int sourceFrame; // negative frame index rendered and blended into the output frame
+        float weight;    // weight of the source frame
+    };
+
+    std::optional<Crossfade> CrossfadeFor(int frameIdx) const {
+        int oldFrameIdx = frameIdx - numFrames;
+        if (oldFrameIdx < -lerpFrames) {
+            return std::nullopt;
+        }
+        return Crossfade{oldFrameIdx, (oldFrameIdx + lerpFrames + 1.0f) / (lerpFrames + 1.0f)};
+    }
+};
@@ -0,0 +1,232 @@
+#include "LoopRenderer.hpp"
+
+#include <fmt/format.h>
+
+#include <emmintrin.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+LoopRenderer::LoopRenderer(Dx &dx, glm::ivec2 size, LoopTiming timing)
+    : dx_(dx), size_(size), timing_(timing), pool_((uint32_t)size.x, (uint32_t)size.y, 2) {
+    HRESULT hr = S_OK;
+    D3D11_TEXTURE2D_DESC td{
+        .Width = (UINT)size.x,
+        .Height = (UINT)size.y,
+        .MipLevels = 1,
+        .ArraySize = 1,
+        .Format = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB,
+        .SampleDesc = {1, 0},
+        .Usage = D3D11_USAGE_DEFAULT,
+        .BindFlags = D3D11_BIND_RENDER_TARGET,
+        .CPUAccessFlags = 0,
+        .MiscFlags = 0,
+    };
+    hr = dx.dev->CreateTexture2D(&td, nullptr, &target_);
+
+    td.Usage = D3D11_USAGE_STAGING;
+    td.BindFlags = 0;
+    td.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+    hr = dx.dev->CreateTexture2D(&td, nullptr, &stageTex_);
+
+    hr = dx.dev->CreateRenderTargetView(target_, nullptr, &rtv_);
+}
+
+void LoopRenderer::BindViewport() {
+    D3D11_VIEWPORT viewport{.TopLeftX = 0,
+                            .TopLeftY = 0,
+                            .Width = (float)size_.x,
+                            .Height = (float)size_.y,
+                            .MinDepth = 0.0f,
+                            .MaxDepth = 1.0f};
+    dx_.ctx->RSSetViewports(1, &viewport);
+
+    D3D11_RECT scissor{.left = 0, .top = 0, .right = size_.x, .bottom = size_.y};
+    dx_.ctx->RSSetScissorRects(1, &scissor);
+}
+
+std::vector<std::shared_ptr<CardLayer>> LoopRenderer::ComboLayers(CardLayers const &cardLayers,
+                                                                  std::vector<int> const &spec) const {
+    std::vector<std::shared_ptr<CardLayer>> layers;
+    for (auto layerSource : spec) {
+        auto card = cardLayers.atlasCards_[layerSource];
+        card->SetViewTransform(UiMatrix(size_));
+        layers.push_back(card);
+    }
+    return layers;
+}
+
+void LoopRenderer::DrawLayers(std::vector<std::shared_ptr<CardLayer>> const &layers, int frame) {
+    float clearColor[]{0.0f, 0.0f, 0.0f, 1.0f};
+    dx_.ctx->ClearRenderTargetView(rtv_, clearColor);
+    dx_.ctx->OMSetRenderTargets(1, &rtv_.p, nullptr);
+
+    for (auto &layer : layers) {
+        layer->SetTime(timing_.TimeAt(frame));
+        layer->Draw({0, 0}, size_);
+    }
+}
+
+bool LoopRenderer::RenderFrame(std::vector<std::shared_ptr<CardLayer>> const &layers, int frameIdx,
+                               FrameBuffer &out) {
+    auto captureAt = [&](FrameBuffer &img, int frame) {
+        DrawLayers(layers, frame);
+        return ReadbackInto(target_, stageTex_, img);
+    };
+    if (!captureAt(out, frameIdx)) {
+        return false;
+    }
+    if (auto crossfade = timing_.CrossfadeFor(frameIdx)) {
+        FrameLease oldFrame(pool_);
+        if (!captureAt(*oldFrame, crossfade->sourceFrame)) {
+            return false;
+        }
+        Crossfade(out, *oldFrame, *crossfade);
+    }
+    return true;
+}
+
+TiledTarget LoopRenderer::CreateTiledTarget(int width, int height) {
+    TiledTarget ret;
+    D3D11_TEXTURE2D_DESC td{};
+    target_->GetDesc(&td);
+    td.Width = width;
+    td.Height = height;
+    td.BindFlags = 0;
+    dx_.dev->CreateTexture2D(&td, nullptr, &ret.tex);
+    td.Usage = D3D11_USAGE_STAGING;
+    td.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+    dx_.dev->CreateTexture2D(&td, nullptr, &ret.stageTex);
+    ret.pool = std::make_unique<FramePool>(width, height, 2);
+    return ret;
+}
+
+bool LoopRenderer::RenderTiled(std::vector<std::vector<std::shared_ptr<CardLayer>>> const &stacks,
+                               std::vector<PixelRect> const &rects, int frameIdx, TiledTarget &target,
+                               FrameBuffer &out) {
+    auto captureAt = [&](FrameBuffer &img, int frame) {
+        for (size_t i = 0; i < stacks.size(); ++i) {
+            DrawLayers(stacks[i], frame);
+            dx_.ctx->CopySubresourceRegion(target.tex, 0, rects[i].x, rects[i].y, 0, target_, 0, nullptr);
+        }
+        return ReadbackInto(target.tex, target.stageTex, img);
+    };
+    if (!captureAt(out, frameIdx)) {
+        return false;
+    }
+    if (auto crossfade = timing_.CrossfadeFor(frameIdx)) {
+        FrameLease oldFrame(*target.pool);
+        if (!captureAt(*oldFrame, crossfade->sourceFrame)) {
+            return false;
+        }
+        Crossfade(out, *oldFrame, *crossfade);
+    }
+    return true;
+}
+
+bool LoopRenderer::ReadbackInto(ID3D11Texture2D *tex, ID3D11Texture2D *stageTex, FrameBuffer &img) {
+    dx_.ctx->CopyResource(stageTex, tex);
+    D3D11_MAPPED_SUBRESOURCE mapped{};
+    HRESULT hr = dx_.ctx->Map(stageTex, 0, D3D11_MAP_READ, 0, &mapped);
+    if (FAILED(hr)) {
+        fmt::print("Staging texture map failure: {}\n", hr);
+        return false;
+    }
+    for (uint32_t row = 0; row < img.height; ++row) {
+        memcpy(img.pixels + row * img.rowPitch, (uint8_t const *)mapped.pData + row * mapped.RowPitch,
+               4 * img.width);
+    }
+    dx_.ctx->Unmap(stageTex, 0);
+    return true;
+}
+
+void LoopRenderer::BlendCrossfade(FrameBuffer &out, FrameBuffer const &oldFrame, float lerpFactor) {
+    for (uint32_t row = 0; row < out.height; ++row) {
+        uint8_t *newRow = out.pixels + row * out.rowPitch;
+        uint8_t const *oldRow = oldFrame.pixels + row * oldFrame.rowPitch;
+        for (uint32_t i = 0; i < 4 * out.width; ++i) {
+            newRow[i] = (uint8_t)glm::mix<float>(newRow[i], oldRow[i], lerpFactor);
+        }
+    }
+}
+
+namespace {
+uint32_t FixedWeight(float lerpFactor) { return (uint32_t)std::clamp(std::lround(lerpFactor * 256.0f), 0l, 256l); }
+} // namespace
+
+void LoopRenderer::BlendCrossfadeFixed(FrameBuffer &out, FrameBuffer const &oldFrame, uint32_t weight) {
+    __m128i const zero = _mm_setzero_si128();
+    __m128i const newWeight = _mm_set1_epi16((short)(256 - weight));
+    __m128i const oldWeight = _mm_set1_epi16((short)weight);
+    __m128i const half = _mm_set1_epi16(128);
+    // new * (256 - w) + old * w + 128 is at most 65408, so the sums stay within unsigned 16-bit lanes.
+    auto blendHalf = [&](__m128i n, __m128i o) {
+        __m128i sum = _mm_add_epi16(_mm_mullo_epi16(n, newWeight), _mm_mullo_epi16(o, oldWeight));
+        return _mm_srli_epi16(_mm_add_epi16(sum, half), 8);
+    };
+    for (uint32_t row = 0; row < out.height; ++row) {
+        uint8_t *newRow = out.pixels + row * out.rowPitch;
+        uint8_t const *oldRow = oldFrame.pixels + row * oldFrame.rowPitch;
+        uint32_t i = 0, bytes = 4 * out.width;
+        for (; i + 16 <= bytes; i += 16) {
+            __m128i n = _mm_loadu_si128((__m128i const *)(newRow + i));
+            __m128i o = _mm_loadu_si128((__m128i const *)(oldRow + i));
+            __m128i lo = blendHalf(_mm_unpacklo_epi8(n, zero), _mm_unpacklo_epi8(o, zero));
+            __m128i hi = blendHalf(_mm_unpackhi_epi8(n, zero), _mm_unpackhi_epi8(o, zero));
+            _mm_storeu_si128((__m128i *)(newRow + i), _mm_packus_epi16(lo, hi));
+        }
+        for (; i < bytes; ++i) {
+            newRow[i] = (uint8_t)((newRow[i] * (256 - weight) + oldRow[i] * weight + 128) >> 8);
+        }
+    }
+}
+
+int LoopRenderer::FixedCrossfadeError(float lerpFactor, uint32_t weight) {
+    int ret = 0;
+    for (int n = 0; n < 256; ++n) {
+        for (int o = 0; o < 256; ++o) {
+            int reference = (uint8_t)glm::mix<float>((float)n, (float)o, lerpFactor);
+            int fixed = (int)((n * (256 - weight) + o * weight + 128) >> 8);
+            ret = (std::max)(ret, std::abs(fixed - reference));
+        }
+    }
+    return ret;
+}
+
+int LoopRenderer::UseFixedCrossfade(int toleranceLsb) {
+    fixedWeights_.clear();
+    int ret = -1;
+    for (int frameIdx = timing_.numFrames - timing_.lerpFrames; frameIdx < timing_.numFrames; ++frameIdx) {
+        auto crossfade = timing_.CrossfadeFor(frameIdx);
+        if (!crossfade) {
+            continue;
+        }
+        uint32_t weight = FixedWeight(crossfade->weight);
+        int error = FixedCrossfadeError(crossfade->weight, weight);
+        if (error <= toleranceLsb) {
+            fixedWeights_[crossfade->sourceFrame] = weight;
+            ret = (std::max)(ret, error);
+        }
+    }
+    return ret;
+}
+
+void LoopRenderer::Crossfade(FrameBuffer &out, FrameBuffer const &oldFrame,
+                             LoopTiming::Crossfade const &crossfade) const {
+    if (auto I = fixedWeights_.find(crossfade.sourceFrame); I != fixedWeights_.end()) {
+        BlendCrossfadeFixed(out, oldFrame, I->second);
+    } else {
+        BlendCrossfade(out, oldFrame, crossfade.weight);
+    }
+}
+
+void LoopRenderer::ReportMemory(MemoryReport &report) const {
+    report.Add("render target", "animation", ResourceBytes(target_));
+    report.Add("render target", "animation staging", ResourceBytes(stageTex_));
+    auto &stats = pool_.Stats();
+    report.Add("frame pool",
+               fmt::format("animation ({} allocations, {} acquires)", stats.heapAllocations, stats.acquires),
+               stats.bytesReserved, stats.peakBytesInUse);
+}
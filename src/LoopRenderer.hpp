@@ -0,0 +1,80 @@
+#pragma once
+
+#include "CardLayers.hpp"
+#include "D3D.hpp"
+#include "FramePool.hpp"
+#include "Loop.hpp"
+#include "MemoryStats.hpp"
+
+#include <glm/glm.hpp>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+// Larger render target that several layer stacks are copied into and read back from once per frame.
+struct TiledTarget {
+    CComPtr<ID3D11Texture2D> tex, stageTex;
+    std::unique_ptr<FramePool> pool; // frames of the whole target
+};
+
+// Renders finished loop frames of a combo, crossfade included, through one render target and its staging copy into
+// frames in CPU memory. The frames may be pooled or wrap memory owned by someone else; rows go straight from the
+// mapped staging texture into them.
+struct LoopRenderer {
+    LoopRenderer(Dx &dx, glm::ivec2 size, LoopTiming timing = {});
+
+    glm::ivec2 Size() const { return size_; }
+    LoopTiming const &Timing() const { return timing_; }
+    ID3D11Texture2D *Target() const { return target_; }
+    // Frames of the render target size, two of which are live during the crossfade tail.
+    FramePool &Pool() { return pool_; }
+
+    // Points the viewport and scissor at the render target; call again after drawing anything else on the context.
+    void BindViewport();
+
+    std::vector<std::shared_ptr<CardLayer>> ComboLayers(CardLayers const &cardLayers,
+                                                        std::vector<int> const &spec) const;
+
+    // Draws the layers of one combo at a loop frame into the render target.
+    void DrawLayers(std::vector<std::shared_ptr<CardLayer>> const &layers, int frame);
+
+    // Renders a finished output frame, including the loop crossfade, into out.
+    bool RenderFrame(std::vector<std::shared_ptr<CardLayer>> const &layers, int frameIdx, FrameBuffer &out);
+
+    TiledTarget CreateTiledTarget(int width, int height);
+
+    // Renders a finished frame of every stack into its rectangle of the tiled target, crossfade included, so the whole
+    // frame takes one readback however many stacks it holds.
+    bool RenderTiled(std::vector<std::vector<std::shared_ptr<CardLayer>>> const &stacks,
+                     std::vector<PixelRect> const &rects, int frameIdx, TiledTarget &target, FrameBuffer &out);
+
+    // Copies a render target into a frame through its staging texture, without the per-call allocation that
+    // DirectX::CaptureTexture makes.
+    bool ReadbackInto(ID3D11Texture2D *tex, ID3D11Texture2D *stageTex, FrameBuffer &img);
+
+    // Switches the crossfade to the 8.8 fixed-point blend for every weight of the loop whose error against the fp32
+    // blend, measured over all pairs of input bytes, is at most toleranceLsb. The other weights keep the fp32 blend.
+    // Returns the largest error of the weights switched, or -1 if none were.
+    int UseFixedCrossfade(int toleranceLsb);
+
+    // Reference blend in fp32, truncated to bytes.
+    static void BlendCrossfade(FrameBuffer &out, FrameBuffer const &oldFrame, float lerpFactor);
+    // Same blend in 16-bit lanes with the weight in 256ths, rounded.
+    static void BlendCrossfadeFixed(FrameBuffer &out, FrameBuffer const &oldFrame, uint32_t weight);
+    // Largest difference between the two blends at a weight, over every pair of new and old bytes.
+    static int FixedCrossfadeError(float lerpFactor, uint32_t weight);
+
+    void ReportMemory(MemoryReport &report) const;
+
+  private:
+    void Crossfade(FrameBuffer &out, FrameBuffer const &oldFrame, LoopTiming::Crossfade const &crossfade) const;
+
+    Dx &dx_;
+    glm::ivec2 size_;
+    LoopTiming timing_;
+    CComPtr<ID3D11Texture2D> target_, stageTex_;
+    CComPtr<ID3D11RenderTargetView> rtv_;
+    FramePool pool_;
+    std::map<int, uint32_t> fixedWeights_; // by crossfade source frame, the weights blended in fixed point
+};
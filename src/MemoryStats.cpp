@@ -0,0 +1,122 @@
+#include "MemoryStats.hpp"
+#include "Util.hpp"
+
+#include <DirectXTex.h>
+#include <fmt/format.h>
+
+#include <windows.h>
+#include <psapi.h>
+
+#include <algorithm>
+#include <map>
+
+uint64_t ResourceBytes(ID3D11Resource *resource) {
+    if (!resource) {
+        return 0;
+    }
+    D3D11_RESOURCE_DIMENSION dim{};
+    resource->GetType(&dim);
+    uint64_t total = 0;
+    auto mipBytes = [&](DXGI_FORMAT format, UINT width, UINT height) {
+        size_t rowPitch{}, slicePitch{};
+        DirectX::ComputePitch(format, width, height, rowPitch, slicePitch);
+        return (uint64_t)slicePitch;
+    };
+    switch (dim) {
+    case D3D11_RESOURCE_DIMENSION_BUFFER: {
+        D3D11_BUFFER_DESC desc{};
+        static_cast<ID3D11Buffer *>(resource)->GetDesc(&desc);
+        total = desc.ByteWidth;
+        break;
+    }
+    case D3D11_RESOURCE_DIMENSION_TEXTURE2D: {
+        D3D11_TEXTURE2D_DESC desc{};
+        static_cast<ID3D11Texture2D *>(resource)->GetDesc(&desc);
+        for (UINT mip = 0; mip < desc.MipLevels; ++mip) {
+            total += mipBytes(desc.Format, (std::max)(desc.Width >> mip, 1u), (std::max)(desc.Height >> mip, 1u));
+        }
+        total *= desc.ArraySize * (std::max)(desc.SampleDesc.Count, 1u);
+        break;
+    }
+    case D3D11_RESOURCE_DIMENSION_TEXTURE3D: {
+        D3D11_TEXTURE3D_DESC desc{};
+        static_cast<ID3D11Texture3D *>(resource)->GetDesc(&desc);
+        for (UINT mip = 0; mip < desc.MipLevels; ++mip) {
+            total += mipBytes(desc.Format, (std::max)(desc.Width >> mip, 1u), (std::max)(desc.Height >> mip, 1u)) *
+                     (std::max)(desc.Depth >> mip, 1u);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+    return total;
+}
+
+void MemoryReport::Add(std::string category, std::string name, uint64_t bytes, uint64_t peakBytes) {
+    entries.push_back({std::move(category), std::move(name), bytes, (std::max)(bytes, peakBytes), false});
+}
+
+void MemoryReport::Attribute(std::string category, std::string name, uint64_t bytes) {
+    entries.push_back({std::move(category), std::move(name), bytes, bytes, true});
+}
+
+void MemoryReport::AddProcessCounters() {
+    PROCESS_MEMORY_COUNTERS pmc{.cb = sizeof(pmc)};
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+        Attribute("process", "working set", pmc.WorkingSetSize);
+        entries.back().peakBytes = pmc.PeakWorkingSetSize;
+        Attribute("process", "commit", pmc.PagefileUsage);
+        entries.back().peakBytes = pmc.PeakPagefileUsage;
+    }
+}
+
+namespace {
+std::string FormatBytes(uint64_t bytes) {
+    if (bytes >= (1ull << 20)) {
+        return fmt::format("{:.1f} MiB", bytes / double(1ull << 20));
+    }
+    return fmt::format("{:.1f} KiB", bytes / 1024.0);
+}
+} // namespace
+
+void MemoryReport::Print(size_t largestPerCategory) const {
+    std::map<std::string, std::vector<Entry const *>> byCategory;
+    uint64_t residentTotal = 0, residentPeak = 0;
+    for (auto &entry : entries) {
+        byCategory[entry.category].push_back(&entry);
+        if (!entry.attribution) {
+            residentTotal += entry.bytes;
+            residentPeak += entry.peakBytes;
+        }
+    }
+    fmt::print("Memory: {} tracked, {} at peak.\n", FormatBytes(residentTotal), FormatBytes(residentPeak));
+    for (auto &[category, list] : byCategory) {
+        uint64_t sum = 0, peak = 0;
+        for (auto *entry : list) {
+            sum += entry->bytes;
+            peak += entry->peakBytes;
+        }
+        fmt::print("  {}{}: {} in {} entries (peak {})\n", category, list.front()->attribution ? " (not in total)" : "",
+                   FormatBytes(sum), list.size(), FormatBytes(peak));
+        std::sort(list.begin(), list.end(), [](auto *l, auto *r) { return l->bytes > r->bytes; });
+        for (size_t i = 0; i < (std::min)(list.size(), largestPerCategory); ++i) {
+            fmt::print("    {:>12}  {}\n", FormatBytes(list[i]->bytes), list[i]->name);
+        }
+    }
+}
+
+bool MemoryReport::WriteJson(std::filesystem::path const &path) const {
+    std::string json = "[";
+    for (size_t i = 0; i < entries.size(); ++i) {
+        auto &entry = entries[i];
+        auto name = entry.name;
+        std::replace(name.begin(), name.end(), '\\', '/');
+        json += fmt::format("{}\n  {{\"category\": \"{}\", \"name\": \"{}\", \"bytes\": {}, \"peakBytes\": {}, "
+                            "\"shared\": {}}}",
+                            i ? "," : "", JsonEscape(entry.category), JsonEscape(name), entry.bytes, entry.peakBytes,
+                            entry.attribution);
+    }
+    json += "\n]\n";
+    return WriteTextFile(path, json);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <d3d11.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Bytes of memory held by a D3D11 texture or buffer across all its subresources.
+uint64_t ResourceBytes(ID3D11Resource *resource);
+
+// Snapshot of where the tool's memory goes. Entries in resident categories own their bytes and add up to the
+// total; attribution categories, like layers, describe which owner uses shared memory and are listed separately.
+struct MemoryReport {
+    struct Entry {
+        std::string category;
+        std::string name;
+        uint64_t bytes{};
+        uint64_t peakBytes{};
+        bool attribution{};
+    };
+    std::vector<Entry> entries;
+
+    void Add(std::string category, std::string name, uint64_t bytes, uint64_t peakBytes = 0);
+    void Attribute(std::string category, std::string name, uint64_t bytes);
+
+    // Samples the process working set and commit charge, with their peaks, from the OS.
+    void AddProcessCounters();
+
+    void Print(size_t largestPerCategory = 5) const;
+    bool WriteJson(std::filesystem::path const &path) const;
+};
@@ -0,0 +1,42 @@
+#include "Packing.hpp"
+#include "Util.hpp"
+
+#include <fmt/format.h>
+#include <fmt/ranges.h>
+
+#include <algorithm>
+#include <cmath>
+
+PackedLayout PackTiles(std::vector<std::string> const &names, std::vector<std::vector<int>> const &layers, int tileWidth,
+                       int tileHeight) {
+    PackedLayout ret;
+    int count = (int)names.size();
+    ret.columns = (std::max)(1, (int)std::ceil(std::sqrt((double)count)));
+    ret.rows = (std::max)(1, (count + ret.columns - 1) / ret.columns);
+    ret.width = ret.columns * tileWidth;
+    ret.height = ret.rows * tileHeight;
+    for (int i = 0; i < count; ++i) {
+        ret.tiles.push_back({
+            .name = names[i],
+            .layers = layers[i],
+            .rect = {(i % ret.columns) * tileWidth, (i / ret.columns) * tileHeight, tileWidth, tileHeight},
+        });
+    }
+    return ret;
+}
+
+bool WritePackedManifest(std::filesystem::path const &path, PackedLayout const &layout, std::string const &framePattern,
+                         int numFrames, float fps) {
+    std::string json = fmt::format("{{\n  \"width\": {},\n  \"height\": {},\n  \"frames\": {},\n  \"fps\": {},\n"
+                                   "  \"framePattern\": \"{}\",\n  \"tiles\": [",
+                                   layout.width, layout.height, numFrames, fps, JsonEscape(framePattern));
+    for (size_t i = 0; i < layout.tiles.size(); ++i) {
+        auto &tile = layout.tiles[i];
+        json += fmt::format("{}\n    {{\"name\": \"{}\", \"layers\": [{}], \"x\": {}, \"y\": {}, \"width\": {}, "
+                            "\"height\": {}}}",
+                            i ? "," : "", JsonEscape(tile.name), fmt::join(tile.layers, ", "), tile.rect.x, tile.rect.y,
+                            tile.rect.width, tile.rect.height);
+    }
+    json += "\n  ]\n}\n";
+    return WriteTextFile(path, json);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "FramePool.hpp"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Placement of several equally sized animations in one frame, so a single decoded stream can serve every combo.
+struct PackedLayout {
+    int width{}, height{};
+    int columns{}, rows{};
+    struct Tile {
+        std::string name;
+        std::vector<int> layers;
+        PixelRect rect;
+    };
+    std::vector<Tile> tiles;
+};
+
+// Lays tiles out row-major on the most square grid that fits them.
+PackedLayout PackTiles(std::vector<std::string> const &names, std::vector<std::vector<int>> const &layers, int tileWidth,
+                       int tileHeight);
+
+// Writes the layout as JSON for the page that crops tiles out of the packed stream.
+bool WritePackedManifest(std::filesystem::path const &path, PackedLayout const &layout, std::string const &framePattern,
+                         int numFrames, float fps);
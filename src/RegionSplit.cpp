@@ -0,0 +1,203 @@
+#include "RegionSplit.hpp"
+#include "Util.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+
+void TemporalStats::Reset(uint32_t width, uint32_t height) {
+    width_ = width;
+    height_ = height;
+    frames_ = 0;
+    size_t n = 4 * (size_t)width * height;
+    sum_.assign(n, 0);
+    sumSq_.assign(n, 0);
+    min_.assign(n, 0xFF);
+    max_.assign(n, 0x00);
+}
+
+void TemporalStats::Accumulate(FrameBuffer const &frame) {
+    for (uint32_t y = 0; y < height_; ++y) {
+        uint8_t const *row = frame.pixels + y * frame.rowPitch;
+        size_t base = 4 * (size_t)y * width_;
+        for (uint32_t i = 0; i < 4 * width_; ++i) {
+            uint32_t v = row[i];
+            sum_[base + i] += v;
+            sumSq_[base + i] += v * v;
+            min_[base + i] = (std::min)(min_[base + i], row[i]);
+            max_[base + i] = (std::max)(max_[base + i], row[i]);
+        }
+    }
+    ++frames_;
+}
+
+bool TemporalStats::IsAnimated(int x, int y, float maxStdDev, int maxRange) const {
+    if (frames_ == 0) {
+        return false;
+    }
+    size_t base = 4 * ((size_t)y * width_ + x);
+    double maxVariance = (double)maxStdDev * maxStdDev;
+    for (size_t c = 0; c < 4; ++c) {
+        if (max_[base + c] - min_[base + c] > maxRange) {
+            return true;
+        }
+        double mean = (double)sum_[base + c] / frames_;
+        double variance = (double)sumSq_[base + c] / frames_ - mean * mean;
+        if (variance > maxVariance) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void TemporalStats::MeanInto(FrameBuffer &out) const {
+    uint32_t frames = (std::max)(frames_, 1u);
+    for (uint32_t y = 0; y < height_; ++y) {
+        uint8_t *row = out.pixels + y * out.rowPitch;
+        size_t base = 4 * (size_t)y * width_;
+        for (uint32_t i = 0; i < 4 * width_; ++i) {
+            row[i] = (uint8_t)((sum_[base + i] + frames / 2) / frames);
+        }
+    }
+}
+
+namespace {
+struct AnimatedMask {
+    int width, height;
+    std::vector<uint8_t> bits;
+
+    bool At(int x, int y) const { return bits[y * width + x] != 0; }
+
+    bool RowAnimated(PixelRect const &r, int y) const {
+        for (int x = r.x; x < r.x + r.width; ++x) {
+            if (At(x, y)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool ColumnAnimated(PixelRect const &r, int x) const {
+        for (int y = r.y; y < r.y + r.height; ++y) {
+            if (At(x, y)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Shrinks a rectangle to the bounding box of its animated pixels.
+    PixelRect Tighten(PixelRect r) const {
+        while (r.height > 0 && !RowAnimated(r, r.y)) {
+            ++r.y, --r.height;
+        }
+        while (r.height > 0 && !RowAnimated(r, r.y + r.height - 1)) {
+            --r.height;
+        }
+        while (r.width > 0 && !ColumnAnimated(r, r.x)) {
+            ++r.x, --r.width;
+        }
+        while (r.width > 0 && !ColumnAnimated(r, r.x + r.width - 1)) {
+            --r.width;
+        }
+        return r.Empty() ? PixelRect{} : r;
+    }
+
+    // Finds the widest run of static rows (or columns) strictly inside a tight rectangle, splitting it into the
+    // parts on either side of that gap.
+    bool Split(PixelRect const &r, PixelRect &a, PixelRect &b) const {
+        int bestGap = 0, bestStart = 0;
+        bool bestIsRow = true;
+        auto scan = [&](int begin, int end, bool isRow) {
+            int runStart = -1;
+            for (int i = begin; i < end; ++i) {
+                bool animated = isRow ? RowAnimated(r, i) : ColumnAnimated(r, i);
+                if (!animated && runStart < 0) {
+                    runStart = i;
+                } else if (animated && runStart >= 0) {
+                    if (i - runStart > bestGap) {
+                        bestGap = i - runStart, bestStart = runStart, bestIsRow = isRow;
+                    }
+                    runStart = -1;
+                }
+            }
+        };
+        scan(r.y, r.y + r.height, true);
+        scan(r.x, r.x + r.width, false);
+        if (bestGap == 0) {
+            return false;
+        }
+        if (bestIsRow) {
+            a = Tighten({r.x, r.y, r.width, bestStart - r.y});
+            b = Tighten({r.x, bestStart + bestGap, r.width, r.y + r.height - bestStart - bestGap});
+        } else {
+            a = Tighten({r.x, r.y, bestStart - r.x, r.height});
+            b = Tighten({bestStart + bestGap, r.y, r.x + r.width - bestStart - bestGap, r.height});
+        }
+        return true;
+    }
+};
+
+PixelRect Align(PixelRect r, int alignment, int width, int height) {
+    int x0 = r.x / alignment * alignment;
+    int y0 = r.y / alignment * alignment;
+    int x1 = (std::min)((r.x + r.width + alignment - 1) / alignment * alignment, width);
+    int y1 = (std::min)((r.y + r.height + alignment - 1) / alignment * alignment, height);
+    return {x0, y0, x1 - x0, y1 - y0};
+}
+} // namespace
+
+std::vector<PixelRect> FindAnimatedRegions(TemporalStats const &stats, RegionSplitSettings const &settings) {
+    AnimatedMask mask{
+        .width = (int)stats.Width(),
+        .height = (int)stats.Height(),
+        .bits = std::vector<uint8_t>((size_t)stats.Width() * stats.Height()),
+    };
+    for (int y = 0; y < mask.height; ++y) {
+        for (int x = 0; x < mask.width; ++x) {
+            mask.bits[y * mask.width + x] = stats.IsAnimated(x, y, settings.maxStdDev, settings.maxRange);
+        }
+    }
+
+    std::vector<PixelRect> regions;
+    if (auto whole = mask.Tighten({0, 0, mask.width, mask.height}); !whole.Empty()) {
+        regions.push_back(whole);
+    }
+    // Greedily split the largest region while there is room for more and splitting saves pixels.
+    while ((int)regions.size() < settings.maxRegions) {
+        std::sort(regions.begin(), regions.end(), [](auto &l, auto &r) { return l.Area() > r.Area(); });
+        bool split = false;
+        for (size_t i = 0; i < regions.size() && !split; ++i) {
+            PixelRect a, b;
+            if (mask.Split(regions[i], a, b) && a.Area() + b.Area() < regions[i].Area()) {
+                regions[i] = a;
+                regions.push_back(b);
+                split = true;
+            }
+        }
+        if (!split) {
+            break;
+        }
+    }
+
+    for (auto &r : regions) {
+        r = Align(r, (std::max)(settings.alignment, 1), mask.width, mask.height);
+    }
+    std::sort(regions.begin(), regions.end(), [](auto &l, auto &r) { return l.y != r.y ? l.y < r.y : l.x < r.x; });
+    return regions;
+}
+
+bool WriteRegionManifest(std::filesystem::path const &path, RegionManifest const &manifest) {
+    std::string json = fmt::format("{{\n  \"name\": \"{}\",\n  \"width\": {},\n  \"height\": {},\n  \"frames\": {},\n"
+                                   "  \"fps\": {},\n  \"base\": \"{}\",\n  \"regions\": [",
+                                   JsonEscape(manifest.name), manifest.width, manifest.height, manifest.numFrames,
+                                   manifest.fps, JsonEscape(manifest.base));
+    for (size_t i = 0; i < manifest.regions.size(); ++i) {
+        auto &region = manifest.regions[i];
+        json += fmt::format("{}\n    {{\"x\": {}, \"y\": {}, \"width\": {}, \"height\": {}, \"frames\": \"{}\"}}",
+                            i ? "," : "", region.rect.x, region.rect.y, region.rect.width, region.rect.height,
+                            JsonEscape(region.framePattern));
+    }
+    json += "\n  ]\n}\n";
+    return WriteTextFile(path, json);
+}
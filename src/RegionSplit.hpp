@@ -0,0 +1,62 @@
+#pragma once
+
+#include "FramePool.hpp"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Per-pixel temporal statistics over every frame of a loop, used to separate the parts of a background that animate
+// from the parts that are effectively a still image.
+struct TemporalStats {
+    void Reset(uint32_t width, uint32_t height);
+    void Accumulate(FrameBuffer const &frame);
+
+    // Whether a pixel changes over the loop: its standard deviation in any channel exceeds maxStdDev 8-bit levels, or
+    // its range exceeds maxRange levels, which keeps brief flashes that barely move the variance.
+    bool IsAnimated(int x, int y, float maxStdDev, int maxRange) const;
+
+    // Writes the per-pixel mean of the loop, which is the static content wherever nothing animates.
+    void MeanInto(FrameBuffer &out) const;
+
+    size_t Bytes() const {
+        return sum_.capacity() * sizeof(uint32_t) + sumSq_.capacity() * sizeof(uint64_t) + min_.capacity() +
+               max_.capacity();
+    }
+
+    uint32_t Width() const { return width_; }
+    uint32_t Height() const { return height_; }
+
+  private:
+    uint32_t width_{}, height_{}, frames_{};
+    std::vector<uint32_t> sum_;
+    std::vector<uint64_t> sumSq_;
+    std::vector<uint8_t> min_, max_;
+};
+
+struct RegionSplitSettings {
+    float maxStdDev = 1.0f;
+    int maxRange = 8;
+    int maxRegions = 4;
+    int alignment = 2; // region edges snap to this many pixels, 4:2:0 video needs even sizes
+};
+
+// Covers the animated pixels with at most maxRegions rectangles, splitting the bounding box along the widest band of
+// static rows or columns as long as that shrinks the total area.
+std::vector<PixelRect> FindAnimatedRegions(TemporalStats const &stats, RegionSplitSettings const &settings);
+
+struct RegionManifest {
+    std::string name;
+    int width{}, height{};
+    std::string base;
+    struct Region {
+        PixelRect rect;
+        std::string framePattern;
+    };
+    std::vector<Region> regions;
+    int numFrames{};
+    float fps{};
+};
+
+// Writes a JSON manifest placing the animated regions over the static base.
+bool WriteRegionManifest(std::filesystem::path const &path, RegionManifest const &manifest);
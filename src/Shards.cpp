@@ -0,0 +1,206 @@
+#include "Shards.hpp"
+
+#include <fmt/format.h>
+#include <fmt/xchar.h>
+
+#include <windows.h>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <deque>
+
+std::optional<IndexRange> ParseIndexRange(std::string_view text) {
+    auto parseInt = [](std::string_view s) -> std::optional<int> {
+        int value{};
+        auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), value);
+        if (ec != std::errc{} || ptr != s.data() + s.size() || value < 0) {
+            return std::nullopt;
+        }
+        return value;
+    };
+    auto dash = text.find('-');
+    auto first = parseInt(text.substr(0, dash));
+    auto last = dash == std::string_view::npos ? first : parseInt(text.substr(dash + 1));
+    if (!first || !last || *last < *first) {
+        return std::nullopt;
+    }
+    return IndexRange{*first, *last + 1};
+}
+
+std::string ShardSpec::Name() const {
+    return fmt::format("c{}-{}_f{}-{}", combos.begin, combos.end - 1, frames.begin, frames.end - 1);
+}
+
+std::string ShardSpec::CommandLineArgs() const {
+    return fmt::format("--combos {}-{} --frames {}-{}{}", combos.begin, combos.end - 1, frames.begin, frames.end - 1,
+                       packed ? " --packed" : "");
+}
+
+std::vector<ShardSpec> PlanShards(int comboCount, int framesPerCombo, int framesPerShard, bool packed) {
+    std::vector<ShardSpec> ret;
+    framesPerShard = (std::max)(framesPerShard, 1);
+    if (packed) {
+        for (int frame = 0; frame < framesPerCombo; frame += framesPerShard) {
+            ret.push_back(ShardSpec{.combos = {0, comboCount},
+                                    .frames = {frame, (std::min)(frame + framesPerShard, framesPerCombo)},
+                                    .packed = true});
+        }
+        return ret;
+    }
+    for (int combo = 0; combo < comboCount; ++combo) {
+        for (int frame = 0; frame < framesPerCombo; frame += framesPerShard) {
+            ret.push_back(ShardSpec{.combos = {combo, combo + 1},
+                                    .frames = {frame, (std::min)(frame + framesPerShard, framesPerCombo)}});
+        }
+    }
+    return ret;
+}
+
+ShardCoordinator::ShardCoordinator(ShardCoordinatorSettings settings) : settings_(std::move(settings)) {}
+
+bool ShardCoordinator::Stitch(ShardSpec const &shard, std::filesystem::path const &stagingDir) {
+    std::error_code ec{};
+    std::vector<std::filesystem::path> files;
+    size_t frames = 0;
+    for (auto &entry : std::filesystem::directory_iterator(stagingDir, ec)) {
+        if (entry.is_regular_file()) {
+            files.push_back(entry.path());
+            auto ext = entry.path().extension();
+            frames += ext == ".png" || ext == ".qoi";
+        }
+    }
+    size_t expected = shard.ExpectedFrames();
+    if (frames != expected) {
+        fmt::print("Shard {} produced {} of {} frames.\n", shard.Name(), frames, expected);
+        return false;
+    }
+    for (auto &frame : files) {
+        rename(frame, settings_.exportRoot / frame.filename(), ec);
+        if (ec) {
+            fmt::print("Shard {} could not move {}: {}\n", shard.Name(), frame.filename().string(), ec.message());
+            return false;
+        }
+    }
+    remove_all(stagingDir, ec);
+    return true;
+}
+
+bool ShardCoordinator::Run(std::vector<ShardSpec> const &shards) {
+    using Clock = std::chrono::steady_clock;
+
+    struct Pending {
+        size_t shardIdx;
+        int attempt;
+    };
+    struct Running {
+        Pending work;
+        PROCESS_INFORMATION pi;
+        std::filesystem::path stagingDir;
+        Clock::time_point start;
+    };
+
+    // Workers are waited on together, which caps them at the handles one wait takes.
+    if (settings_.workerCommands.size() > MAXIMUM_WAIT_OBJECTS) {
+        fmt::print("{} worker slots given, at most {} are supported.\n", settings_.workerCommands.size(),
+                   MAXIMUM_WAIT_OBJECTS);
+        return false;
+    }
+
+    std::deque<Pending> queue;
+    for (size_t i = 0; i < shards.size(); ++i) {
+        queue.push_back({i, 1});
+    }
+    std::vector<std::optional<Running>> slots(settings_.workerCommands.size());
+    size_t failed = 0;
+    auto shardsRoot = settings_.exportRoot / ".shards";
+
+    auto launch = [&](size_t slotIdx, Pending work) {
+        auto &shard = shards[work.shardIdx];
+        auto stagingDir = shardsRoot / fmt::format("{}-a{}", shard.Name(), work.attempt);
+        std::error_code ec{};
+        remove_all(stagingDir, ec);
+        create_directories(stagingDir, ec);
+
+        auto args = shard.CommandLineArgs();
+        std::wstring cmdLine = fmt::format(L"{} {} --out \"{}\"", settings_.workerCommands[slotIdx],
+                                           std::wstring(args.begin(), args.end()), stagingDir.wstring());
+        STARTUPINFOW si{.cb = sizeof(si)};
+        PROCESS_INFORMATION pi{};
+        if (!CreateProcessW(nullptr, cmdLine.data(), nullptr, nullptr, FALSE, 0, nullptr, nullptr, &si, &pi)) {
+            fmt::print("Shard {} failed to launch: {}\n", shard.Name(), GetLastError());
+            remove_all(stagingDir, ec);
+            return false;
+        }
+        CloseHandle(pi.hThread);
+        slots[slotIdx] = Running{work, pi, stagingDir, Clock::now()};
+        return true;
+    };
+
+    auto retryOrFail = [&](Pending work) {
+        auto &shard = shards[work.shardIdx];
+        if (work.attempt < settings_.maxAttempts) {
+            fmt::print("Shard {} attempt {} failed, retrying.\n", shard.Name(), work.attempt);
+            queue.push_back({work.shardIdx, work.attempt + 1});
+        } else {
+            fmt::print("Shard {} failed after {} attempts.\n", shard.Name(), work.attempt);
+            ++failed;
+        }
+    };
+
+    while (true) {
+        for (size_t slotIdx = 0; slotIdx < slots.size() && !queue.empty(); ++slotIdx) {
+            if (!slots[slotIdx]) {
+                auto work = queue.front();
+                queue.pop_front();
+                if (!launch(slotIdx, work)) {
+                    retryOrFail(work);
+                }
+            }
+        }
+
+        std::vector<HANDLE> handles;
+        std::vector<size_t> handleSlots;
+        for (size_t slotIdx = 0; slotIdx < slots.size(); ++slotIdx) {
+            if (slots[slotIdx]) {
+                handles.push_back(slots[slotIdx]->pi.hProcess);
+                handleSlots.push_back(slotIdx);
+            }
+        }
+        if (handles.empty()) {
+            if (queue.empty()) {
+                break;
+            }
+            continue;
+        }
+
+        DWORD waited = WaitForMultipleObjects((DWORD)handles.size(), handles.data(), FALSE, INFINITE);
+        if (waited >= WAIT_OBJECT_0 + handles.size()) {
+            fmt::print("Waiting on shard workers failed: {}\n", GetLastError());
+            return false;
+        }
+        size_t slotIdx = handleSlots[waited - WAIT_OBJECT_0];
+        Running done = std::move(*slots[slotIdx]);
+        slots[slotIdx].reset();
+
+        DWORD exitCode{};
+        GetExitCodeProcess(done.pi.hProcess, &exitCode);
+        CloseHandle(done.pi.hProcess);
+
+        auto &shard = shards[done.work.shardIdx];
+        auto seconds = std::chrono::duration<double>(Clock::now() - done.start).count();
+        if (exitCode == 0 && Stitch(shard, done.stagingDir)) {
+            fmt::print("Shard {} done in {:.2f} s on worker {}.\n", shard.Name(), seconds, slotIdx);
+        } else {
+            fmt::print("Shard {} exited with code {}.\n", shard.Name(), exitCode);
+            std::error_code ec{};
+            remove_all(done.stagingDir, ec);
+            retryOrFail(done.work);
+        }
+    }
+
+    std::error_code ec{};
+    remove(shardsRoot, ec);
+    fmt::print("{} of {} shards completed.\n", shards.size() - failed, shards.size());
+    return failed == 0;
+}
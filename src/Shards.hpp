@@ -0,0 +1,58 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Half-open range of indices.
+struct IndexRange {
+    int begin{}, end{};
+
+    int Size() const { return end - begin; }
+    bool Contains(int i) const { return i >= begin && i < end; }
+};
+
+// Parses an inclusive "first-last" or single "n" range from the command line.
+std::optional<IndexRange> ParseIndexRange(std::string_view text);
+
+// A unit of batch work: a block of frames for a block of combos. Shards only name global frame indices, so the
+// output of a shard is identical to the same frames out of an unsharded export.
+struct ShardSpec {
+    IndexRange combos;
+    IndexRange frames;
+    bool packed{}; // combos are tiled into one packed frame sequence
+
+    int ExpectedFrames() const { return packed ? frames.Size() : combos.Size() * frames.Size(); }
+
+    std::string Name() const;
+    std::string CommandLineArgs() const;
+};
+
+// Splits each combo's frames into shards, or with packed output splits the frames of the shared packed sequence.
+std::vector<ShardSpec> PlanShards(int comboCount, int framesPerCombo, int framesPerShard, bool packed = false);
+
+struct ShardCoordinatorSettings {
+    // One entry per worker slot; each is the command prefix that launches a divfx worker, for example the local
+    // executable or a remote shell wrapper around one on a render node.
+    std::vector<std::wstring> workerCommands;
+    std::filesystem::path exportRoot;
+    int maxAttempts = 3;
+};
+
+// Runs shards on a pool of worker processes. Each attempt renders into its own staging directory whose files are moved
+// into the export root once the worker exits cleanly with every expected frame present, so retries never see partial
+// output.
+struct ShardCoordinator {
+    explicit ShardCoordinator(ShardCoordinatorSettings settings);
+
+    // Fails up front when given more worker slots than MAXIMUM_WAIT_OBJECTS. Failed attempts' staging directories are
+    // removed before the retry.
+    bool Run(std::vector<ShardSpec> const &shards);
+
+  private:
+    bool Stitch(ShardSpec const &shard, std::filesystem::path const &stagingDir);
+
+    ShardCoordinatorSettings settings_;
+};
@@ -0,0 +1,162 @@
+#include "Stress.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <span>
+#include <thread>
+
+namespace {
+// Blocks until the GPU has finished everything submitted so far.
+void WaitForGpu(Dx &dx, ID3D11Query *query) {
+    dx.ctx->End(query);
+    while (dx.ctx->GetData(query, nullptr, 0, 0) == S_FALSE) {
+        std::this_thread::yield();
+    }
+}
+
+struct StressCard {
+    std::vector<int> const *combo;
+    glm::ivec2 pos;
+    int frameOffset;
+};
+
+// Draws of one layer across every card using it at one depth of their combos.
+struct StressPass {
+    std::shared_ptr<CardLayer> layer;
+    std::vector<CardInstance> instances;
+    std::vector<int> frameOffsets;
+};
+} // namespace
+
+int RunStress(Dx &dx, CardLayers &cardLayers, LoopTiming const &timing, StressSettings const &settings) {
+    if (cardLayers.combos_.empty()) {
+        fmt::print("The layer catalog lists no combos to draw.\n");
+        return 2;
+    }
+
+    auto size = settings.targetSize;
+    CComPtr<ID3D11Texture2D> target;
+    CComPtr<ID3D11RenderTargetView> rtv;
+    CComPtr<ID3D11Query> done;
+    D3D11_TEXTURE2D_DESC td{
+        .Width = (UINT)size.x,
+        .Height = (UINT)size.y,
+        .MipLevels = 1,
+        .ArraySize = 1,
+        .Format = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB,
+        .SampleDesc = {1, 0},
+        .Usage = D3D11_USAGE_DEFAULT,
+        .BindFlags = D3D11_BIND_RENDER_TARGET,
+    };
+    HRESULT hr = dx.dev->CreateTexture2D(&td, nullptr, &target);
+    if (SUCCEEDED(hr)) {
+        hr = dx.dev->CreateRenderTargetView(target, nullptr, &rtv);
+    }
+    D3D11_QUERY_DESC qd{.Query = D3D11_QUERY_EVENT};
+    if (SUCCEEDED(hr)) {
+        hr = dx.dev->CreateQuery(&qd, &done);
+    }
+    if (FAILED(hr)) {
+        fmt::print("Stress target creation failure: {}\n", hr);
+        return 1;
+    }
+
+    D3D11_VIEWPORT viewport{.Width = (float)size.x, .Height = (float)size.y, .MinDepth = 0.0f, .MaxDepth = 1.0f};
+    dx.ctx->RSSetViewports(1, &viewport);
+    D3D11_RECT scissor{.left = 0, .top = 0, .right = size.x, .bottom = size.y};
+    dx.ctx->RSSetScissorRects(1, &scissor);
+    for (auto &layer : cardLayers.atlasCards_) {
+        layer->SetViewTransform(UiMatrix(size));
+    }
+
+    glm::ivec2 cardSize{eCardWidth, eCardHeight};
+    int columns = (std::max)(size.x / eCardWidth, 1), rows = (std::max)(size.y / eCardHeight, 1);
+    std::vector<int> counts;
+    for (int count = 1; count < settings.maxCards; count *= 2) {
+        counts.push_back(count);
+    }
+    counts.push_back((std::max)(settings.maxCards, 1));
+
+    fmt::print("{:>6} {:>8} {:>8} {:>9} {:>8}\n", "cards", "mode", "fps", "ms/frame", "us/card");
+    for (int count : counts) {
+        // Card i shows the combos in turn and runs its loop a spread-out number of frames ahead of the others. Cards
+        // beyond one target's worth of slots wrap around and are drawn over the earlier ones.
+        int slots = columns * rows;
+        std::vector<StressCard> cards;
+        for (int i = 0; i < count; ++i) {
+            int slot = i % slots;
+            cards.push_back({
+                .combo = &cardLayers.combos_[i % cardLayers.combos_.size()],
+                .pos = glm::ivec2(slot % columns, slot / columns) * cardSize,
+                .frameOffset = (int)((int64_t)i * 7919 % timing.numFrames),
+            });
+        }
+
+        // Cards sharing no pixels can be drawn in any order as long as each one's layers keep theirs, so the cards of
+        // one wrap around the target draw their n-th layers before any (n+1)-th one, one batch per distinct layer.
+        // Each wrap is batched only after the one below it, which keeps the overdraw the same as per-card drawing.
+        std::vector<StressPass> passes;
+        for (int wrapBegin = 0; wrapBegin < count; wrapBegin += slots) {
+            auto wrapCards = std::span(cards).subspan(wrapBegin, (std::min)(slots, count - wrapBegin));
+            for (size_t depth = 0;; ++depth) {
+                std::map<int, StressPass> byLayer;
+                for (auto &card : wrapCards) {
+                    if (depth < card.combo->size()) {
+                        int layerIdx = (*card.combo)[depth];
+                        auto &pass = byLayer[layerIdx];
+                        pass.layer = cardLayers.atlasCards_[layerIdx];
+                        pass.instances.push_back({.pos = card.pos, .size = cardSize});
+                        pass.frameOffsets.push_back(card.frameOffset);
+                    }
+                }
+                if (byLayer.empty()) {
+                    break;
+                }
+                for (auto &[layerIdx, pass] : byLayer) {
+                    passes.push_back(std::move(pass));
+                }
+            }
+        }
+
+        auto timeAt = [&](int frame, int offset) { return timing.TimeAt((frame + offset) % timing.numFrames); };
+        for (bool batched : {false, true}) {
+            auto drawFrame = [&](int frame) {
+                float clearColor[]{0.0f, 0.0f, 0.0f, 1.0f};
+                dx.ctx->ClearRenderTargetView(rtv, clearColor);
+                dx.ctx->OMSetRenderTargets(1, &rtv.p, nullptr);
+                if (batched) {
+                    for (auto &pass : passes) {
+                        for (size_t i = 0; i < pass.instances.size(); ++i) {
+                            pass.instances[i].time = timeAt(frame, pass.frameOffsets[i]);
+                        }
+                        pass.layer->DrawBatch(pass.instances);
+                    }
+                    return;
+                }
+                for (auto &card : cards) {
+                    for (int layerIdx : *card.combo) {
+                        auto &layer = cardLayers.atlasCards_[layerIdx];
+                        layer->SetTime(timeAt(frame, card.frameOffset));
+                        layer->Draw(card.pos, cardSize);
+                    }
+                }
+            };
+
+            drawFrame(0); // warms up buffers and driver state outside the timed frames
+            WaitForGpu(dx, done);
+            auto start = std::chrono::steady_clock::now();
+            for (int frame = 0; frame < settings.frames; ++frame) {
+                drawFrame(frame);
+            }
+            WaitForGpu(dx, done);
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            double msPerFrame = elapsed.count() / (std::max)(settings.frames, 1);
+            fmt::print("{:>6} {:>8} {:>8.1f} {:>9.3f} {:>8.2f}\n", count, batched ? "batched" : "per-card",
+                       1000.0 / msPerFrame, msPerFrame, 1000.0 * msPerFrame / count);
+        }
+    }
+    return 0;
+}
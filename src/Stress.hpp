@@ -0,0 +1,18 @@
+#pragma once
+
+#include "CardLayers.hpp"
+#include "D3D.hpp"
+#include "Loop.hpp"
+
+#include <glm/glm.hpp>
+
+// Headless measurement of how many animated cards one frame can hold, for sizing pages that show a whole stash.
+// Card counts double from 1 up to maxCards; each count is drawn both one card at a time and batched per layer.
+struct StressSettings {
+    int maxCards = 1024;
+    int frames = 60;                   // timed frames per card count and submission mode
+    glm::ivec2 targetSize{3840, 2160}; // cards past one grid's worth wrap around, drawn over the earlier ones
+};
+
+// Prints frames per second and per-card cost for every card count and mode; returns the process exit code.
+int RunStress(Dx &dx, CardLayers &cardLayers, LoopTiming const &timing, StressSettings const &settings);
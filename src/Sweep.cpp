@@ -0,0 +1,137 @@
+#include "Sweep.hpp"
+#include "Util.hpp"
+
+#include <fmt/format.h>
+
+#include <charconv>
+#include <sstream>
+
+size_t SweepSpec::VariantCount() const {
+    size_t ret = 1;
+    for (auto &axis : axes) {
+        ret *= axis.values.size();
+    }
+    return ret;
+}
+
+std::optional<SweepSpec> LoadSweepSpec(std::filesystem::path const &path) {
+    if (!exists(path)) {
+        fmt::print("Sweep description {} not found.\n", path.string());
+        return std::nullopt;
+    }
+    SweepSpec ret;
+    std::istringstream is(SlurpTextFile(path));
+    std::string line;
+    int lineNo = 0;
+    auto fail = [&](std::string_view what) {
+        fmt::print("{}:{}: {}\n", path.string(), lineNo, what);
+        return std::nullopt;
+    };
+    auto parseInt = [](std::string const &text, int &out) {
+        auto res = std::from_chars(text.data(), text.data() + text.size(), out);
+        return res.ec == std::errc{} && res.ptr == text.data() + text.size() && out >= 0;
+    };
+    while (std::getline(is, line)) {
+        ++lineNo;
+        if (auto hash = line.find('#'); hash != std::string::npos) {
+            line.resize(hash);
+        }
+        std::vector<std::string> tokens;
+        std::istringstream ls(line);
+        for (std::string token; ls >> token;) {
+            tokens.push_back(token);
+        }
+        if (tokens.empty()) {
+            continue;
+        }
+
+        if (tokens[0] == "combo" && tokens.size() == 2) {
+            if (!parseInt(tokens[1], ret.combo)) {
+                return fail("malformed combo index");
+            }
+        } else if (tokens[0] == "columns" && tokens.size() == 2) {
+            if (!parseInt(tokens[1], ret.columns)) {
+                return fail("malformed column count");
+            }
+        } else if (tokens[0] == "vary" && tokens.size() >= 5) {
+            // vary <layer> <type> <field> <value>...; each value lists its components separated by commas
+            SweepAxis axis{.layer = tokens[1]};
+            for (size_t i = 4; i < tokens.size(); ++i) {
+                std::vector<std::string> paramTokens{"param", tokens[2], tokens[3]};
+                std::istringstream vs(tokens[i]);
+                for (std::string component; std::getline(vs, component, ',');) {
+                    paramTokens.push_back(component);
+                }
+                auto value = ParseLayerParam(paramTokens);
+                if (!value) {
+                    return fail(fmt::format("malformed {} value '{}'", tokens[2], tokens[i]));
+                }
+                axis.values.push_back(*value);
+            }
+            ret.axes.push_back(std::move(axis));
+        } else {
+            return fail(fmt::format("unexpected '{}'", tokens[0]));
+        }
+    }
+    if (ret.axes.empty()) {
+        lineNo = 0;
+        return fail("the sweep varies nothing");
+    }
+    return ret;
+}
+
+namespace {
+std::string FormatValue(LayerParamDesc const &value) {
+    std::string ret;
+    for (int i = 0; i < value.components; ++i) {
+        ret += i ? "," : "";
+        ret += value.isUint ? fmt::format("{}", value.bits[i]) : fmt::format("{:g}", value.Float(i));
+    }
+    return ret;
+}
+} // namespace
+
+std::optional<SweepVariants> ExpandSweep(SweepSpec const &spec, LayerCatalog const &catalog) {
+    if (spec.combo < 0 || spec.combo >= (int)catalog.combos.size()) {
+        fmt::print("Sweep combo {} does not exist, layers.txt lists {} combos.\n", spec.combo, catalog.combos.size());
+        return std::nullopt;
+    }
+    auto &combo = catalog.combos[spec.combo];
+    std::vector<LayerDesc> base;
+    for (int layerIdx : combo) {
+        base.push_back(catalog.layers[layerIdx]);
+    }
+    for (auto &axis : spec.axes) {
+        bool found = false;
+        for (auto &desc : base) {
+            found |= desc.name == axis.layer;
+        }
+        if (!found) {
+            fmt::print("Swept layer {} is not part of combo {}.\n", axis.layer, spec.combo);
+            return std::nullopt;
+        }
+    }
+
+    SweepVariants ret;
+    size_t count = spec.VariantCount();
+    for (size_t variant = 0; variant < count; ++variant) {
+        auto layers = base;
+        std::string label;
+        size_t stride = count;
+        for (auto &axis : spec.axes) {
+            stride /= axis.values.size();
+            auto &value = axis.values[variant / stride % axis.values.size()];
+            for (auto &desc : layers) {
+                if (desc.name != axis.layer) {
+                    continue;
+                }
+                std::erase_if(desc.params, [&](auto &param) { return param.field == value.field; });
+                desc.params.push_back(value); // parsed as a param, so never specialized
+            }
+            label += fmt::format("{}{}.{}={}", label.empty() ? "" : " ", axis.layer, value.field, FormatValue(value));
+        }
+        ret.layers.push_back(std::move(layers));
+        ret.labels.push_back(std::move(label));
+    }
+    return ret;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "LayerDesc.hpp"
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Values one cbuffer field of a layer takes across a sweep.
+struct SweepAxis {
+    std::string layer;
+    std::vector<LayerParamDesc> values;
+};
+
+// Grid of parameter values tried on one combo, see data/sweep.txt for the format. Every combination of axis values
+// is one variant.
+struct SweepSpec {
+    int combo{};
+    int columns{}; // 0 picks a near-square grid
+    std::vector<SweepAxis> axes;
+
+    size_t VariantCount() const;
+};
+
+std::optional<SweepSpec> LoadSweepSpec(std::filesystem::path const &path);
+
+// Layer descriptions of every variant of a sweep, the first axis varying slowest. Swept fields are set to the
+// variant's values and left out of the shader specialization, so all variants of a layer share one shader and only
+// differ in their cbuffers.
+struct SweepVariants {
+    std::vector<std::vector<LayerDesc>> layers; // per variant, the combo's layers bottom to top
+    std::vector<std::string> labels;            // per variant, such as "shaper.muddle_frequency=5"
+};
+
+std::optional<SweepVariants> ExpandSweep(SweepSpec const &spec, LayerCatalog const &catalog);
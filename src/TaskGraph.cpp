@@ -0,0 +1,90 @@
+#include "TaskGraph.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+TaskGraph::TaskId TaskGraph::Add(std::string name, std::function<void()> fn, std::vector<TaskId> dependencies) {
+    TaskId id = tasks_.size();
+    for (auto dependency : dependencies) {
+        tasks_[dependency].dependents.push_back(id);
+    }
+    tasks_.push_back({.name = std::move(name), .fn = std::move(fn), .pendingDependencies = (int)dependencies.size()});
+    return id;
+}
+
+void TaskGraph::Run(unsigned threads) {
+    using Clock = std::chrono::steady_clock;
+    auto start = Clock::now();
+    auto sinceStart = [&] { return std::chrono::duration<double, std::milli>(Clock::now() - start).count(); };
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<TaskId> ready;
+    size_t remaining = tasks_.size();
+    for (TaskId id = 0; id < tasks_.size(); ++id) {
+        if (tasks_[id].pendingDependencies == 0) {
+            ready.push_back(id);
+        }
+    }
+
+    auto work = [&](unsigned worker) {
+        std::unique_lock lock(mutex);
+        while (true) {
+            wake.wait(lock, [&] { return !ready.empty() || remaining == 0; });
+            if (remaining == 0) {
+                return;
+            }
+            TaskId id = ready.front();
+            ready.pop_front();
+            auto &task = tasks_[id];
+            lock.unlock();
+
+            task.worker = worker;
+            task.startMs = sinceStart();
+            task.fn();
+            task.endMs = sinceStart();
+
+            lock.lock();
+            --remaining;
+            for (auto dependent : task.dependents) {
+                if (--tasks_[dependent].pendingDependencies == 0) {
+                    ready.push_back(dependent);
+                }
+            }
+            wake.notify_all();
+        }
+    };
+
+    threads_ = std::clamp<unsigned>(threads, 1, (std::max<size_t>)(tasks_.size(), 1));
+    std::vector<std::thread> workers;
+    for (unsigned worker = 1; worker < threads_; ++worker) {
+        workers.emplace_back(work, worker);
+    }
+    work(0);
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    wallMs_ = sinceStart();
+}
+
+void TaskGraph::PrintTimings(std::string_view title) const {
+    double busyMs = 0;
+    for (auto &task : tasks_) {
+        busyMs += task.endMs - task.startMs;
+    }
+    fmt::print("{}: {:.1f} ms on {} threads, {:.1f} ms of work.\n", title, wallMs_, threads_, busyMs);
+    std::vector<Task const *> byStart;
+    for (auto &task : tasks_) {
+        byStart.push_back(&task);
+    }
+    std::sort(byStart.begin(), byStart.end(), [](auto *l, auto *r) { return l->startMs < r->startMs; });
+    for (auto *task : byStart) {
+        fmt::print("  {:7.1f} ms {:7.1f} ms  [{:2}] {}\n", task->startMs, task->endMs - task->startMs, task->worker,
+                   task->name);
+    }
+}
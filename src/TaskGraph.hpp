@@ -0,0 +1,32 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A one-shot graph of named tasks run across worker threads, each starting once its dependencies have finished.
+// Tasks record when and on which worker they ran, so startup costs can be reported per step.
+struct TaskGraph {
+    using TaskId = size_t;
+
+    TaskId Add(std::string name, std::function<void()> fn, std::vector<TaskId> dependencies = {});
+
+    // Runs every task and returns once all have finished. Dependencies must name tasks added earlier.
+    void Run(unsigned threads = std::thread::hardware_concurrency());
+
+    void PrintTimings(std::string_view title) const;
+
+  private:
+    struct Task {
+        std::string name;
+        std::function<void()> fn;
+        std::vector<TaskId> dependents;
+        int pendingDependencies{};
+        unsigned worker{};
+        double startMs{}, endMs{};
+    };
+    std::vector<Task> tasks_;
+    double wallMs_{};
+    unsigned threads_{};
+};
@@ -1,5 +1,10 @@
 #include "Util.hpp"
 
+#include <fmt/format.h>
+#include <fmt/os.h>
+
+#include <algorithm>
+#include <cwctype>
 #include <fstream>
 
 std::string SlurpTextFile(std::filesystem::path const &path) {
@@ -9,3 +14,51 @@ std::string SlurpTextFile(std::filesystem::path const &path) {
     fh.read(ret.data(), ret.size());
     return ret;
 }
+
+bool WriteTextFile(std::filesystem::path const &path, std::string_view text) {
+    try {
+        auto out = fmt::output_file(path.string());
+        out.print("{}", text);
+    } catch (std::system_error const &e) {
+        fmt::print("Could not write {}: {}\n", path.string(), e.what());
+        return false;
+    }
+    return true;
+}
+
+std::string PathKey(std::filesystem::path const &path) {
+    auto normal = path.lexically_normal().generic_wstring();
+    std::transform(normal.begin(), normal.end(), normal.begin(), [](wchar_t ch) { return std::towlower(ch); });
+    return std::filesystem::path(normal).generic_string();
+}
+
+std::string JsonEscape(std::string_view text) {
+    std::string ret;
+    ret.reserve(text.size());
+    for (char c : text) {
+        switch (c) {
+        case '"':
+            ret += "\\\"";
+            break;
+        case '\\':
+            ret += "\\\\";
+            break;
+        case '\n':
+            ret += "\\n";
+            break;
+        case '\r':
+            ret += "\\r";
+            break;
+        case '\t':
+            ret += "\\t";
+            break;
+        default:
+            if ((unsigned char)c < 0x20) {
+                ret += fmt::format("\\u{:04x}", (unsigned char)c);
+            } else {
+                ret += c;
+            }
+        }
+    }
+    return ret;
+}
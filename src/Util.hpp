@@ -2,5 +2,12 @@
 
 #include <filesystem>
 #include <string>
+#include <string_view>
 
-std::string SlurpTextFile(std::filesystem::path const &path);
\ No newline at end of file
+std::string SlurpTextFile(std::filesystem::path const &path);
+// Replaces the file with the text, printing the reason and returning false if it cannot be written.
+bool WriteTextFile(std::filesystem::path const &path, std::string_view text);
+// Comparable form of a path: normalized, forward slashes and lowercase, as paths on Windows are case-insensitive.
+std::string PathKey(std::filesystem::path const &path);
+// Text as the contents of a JSON string literal, quotes not included.
+std::string JsonEscape(std::string_view text);
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <fmt/format.h>
+
+#include <filesystem>
+#include <string>
+
+// Minimal checks for the test executables, which need no framework: a failed check prints its location and is
+// counted, and main returns CheckResult() so ctest sees the failure.
+inline int checkFailures = 0;
+
+#define CHECK(expr)                                                                                                    \
+    do {                                                                                                               \
+        if (!(expr)) {                                                                                                 \
+            fmt::print("{}:{}: CHECK({}) failed\n", __FILE__, __LINE__, #expr);                                        \
+            ++checkFailures;                                                                                           \
+        }                                                                                                              \
+    } while (0)
+
+inline int CheckResult() {
+    if (checkFailures) {
+        fmt::print("{} checks failed.\n", checkFailures);
+    }
+    return checkFailures ? 1 : 0;
+}
+
+// Empty directory under the system temporary directory for a test's files, replacing any left by an earlier run.
+inline std::filesystem::path TestDirectory(std::string const &name) {
+    auto dir = std::filesystem::temp_directory_path() / ("divfx-test-" + name);
+    std::error_code ec;
+    remove_all(dir, ec);
+    create_directories(dir);
+    return dir;
+}
@@ -0,0 +1,85 @@
+#include "Check.hpp"
+
+#include "Checkpoint.hpp"
+#include "ImageCodec.hpp"
+#include "Util.hpp"
+
+namespace {
+void TestParseCheckpointJournal() {
+    auto units = ParseCheckpointJournal("fingerprint 00000000000000ab\n"
+                                        "div_bg_0 0 49 0123456789abcdef\n"
+                                        "div_bg_0 50 99 0123\n"           // short hash
+                                        "div_bg_1 5 4 0123456789abcdef\n" // last before first
+                                        "div_bg_1 0 9 0123456789abcdef extra\n"
+                                        "div_bg_2 0 9 fedcba9876543210\n"
+                                        "div_bg_3 0", // torn by a crash
+                                        0xAB);
+    CHECK(units && units->size() == 2);
+    if (units && units->size() == 2) {
+        auto &first = (*units)[0];
+        CHECK(first.combo == "div_bg_0" && first.frames.begin == 0 && first.frames.end == 50);
+        CHECK(first.hash == 0x0123456789ABCDEFull);
+        CHECK((*units)[1].combo == "div_bg_2" && (*units)[1].frames.end == 10);
+        CHECK((*units)[1].hash == 0xFEDCBA9876543210ull);
+    }
+
+    CHECK(ParseCheckpointJournal("fingerprint 00000000000000ab\n", 0xAB)->empty());
+    CHECK(!ParseCheckpointJournal("fingerprint 00000000000000ac\ndiv_bg_0 0 49 0123456789abcdef\n", 0xAB));
+    CHECK(!ParseCheckpointJournal("div_bg_0 0 49 0123456789abcdef\n", 0xAB));
+    CHECK(!ParseCheckpointJournal("fingerprint ab\n", 0xAB));
+    CHECK(!ParseCheckpointJournal("", 0xAB));
+}
+
+void TestHash() {
+    // FNV-1a reference values.
+    CHECK(HashBytes("", 0) == eFnvOffsetBasis);
+    CHECK(HashBytes("a", 1) == 0xAF63DC4C8601EC8Cull);
+    CHECK(HashBytes("b", 1, HashBytes("a", 1)) == HashBytes("ab", 2));
+
+    auto dir = TestDirectory("checkpoint-hash");
+    CHECK(WriteBinaryFile(dir / "a", {'a'}) && WriteBinaryFile(dir / "b", {'b'}));
+    CHECK(HashFiles({dir / "a", dir / "b"}) == HashBytes("ab", 2));
+    CHECK(!HashFiles({dir / "a", dir / "missing"}));
+}
+
+void TestJournal() {
+    auto dir = TestDirectory("checkpoint-journal");
+    auto journal = dir / "journal.txt";
+    std::vector<std::filesystem::path> files{dir / "f0.png", dir / "f1.png"};
+    CHECK(WriteBinaryFile(files[0], {1, 2, 3}) && WriteBinaryFile(files[1], {4, 5}));
+    {
+        CheckpointJournal checkpoint(journal, 0x1234);
+        CHECK(checkpoint.RecordedUnits() == 0 && !checkpoint.Verified("div_bg_0", {0, 2}, files));
+        CHECK(checkpoint.Record("div_bg_0", {0, 2}, files));
+        CHECK(checkpoint.Verified("div_bg_0", {0, 2}, files));
+        CHECK(!checkpoint.Record("div_bg_0", {2, 4}, {dir / "missing.png"}));
+    }
+    CHECK(SlurpTextFile(journal).starts_with("fingerprint 0000000000001234\ndiv_bg_0 0 1 "));
+
+    // A rerun with the same fingerprint resumes; only the exact unit with unchanged files counts as done.
+    {
+        CheckpointJournal checkpoint(journal, 0x1234);
+        CHECK(checkpoint.RecordedUnits() == 1);
+        CHECK(checkpoint.Verified("div_bg_0", {0, 2}, files));
+        CHECK(!checkpoint.Verified("div_bg_0", {0, 3}, files));
+        CHECK(!checkpoint.Verified("div_bg_1", {0, 2}, files));
+        CHECK(WriteBinaryFile(files[1], {4, 6}));
+        CHECK(!checkpoint.Verified("div_bg_0", {0, 2}, files));
+    }
+
+    // Other inputs or settings start the journal over.
+    {
+        CheckpointJournal checkpoint(journal, 0x5678);
+        CHECK(checkpoint.RecordedUnits() == 0);
+    }
+    CHECK(SlurpTextFile(journal) == "fingerprint 0000000000005678\n");
+    CHECK(CheckpointJournal(journal, 0x1234).RecordedUnits() == 0);
+}
+} // namespace
+
+int main() {
+    TestParseCheckpointJournal();
+    TestHash();
+    TestJournal();
+    return CheckResult();
+}
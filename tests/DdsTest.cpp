@@ -0,0 +1,111 @@
+#include "Check.hpp"
+
+#include "Dds.hpp"
+#include "ImageCodec.hpp"
+
+#include <DirectXTex.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+// A DX10 DDS of an RGBA8 16x8 texture with a full chain of 5 mips, each filled with its level number.
+std::vector<uint8_t> TestDds() {
+    enum : uint32_t { eWidth = 16, eHeight = 8, eMips = 5 };
+    std::vector<uint8_t> ret(148);
+    auto put = [&](size_t offset, uint32_t value) { memcpy(&ret[offset], &value, sizeof(value)); };
+    memcpy(&ret[0], "DDS ", 4);
+    put(4, 124); // header size
+    put(8, 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000); // caps, height, width, pixel format, mip count
+    put(12, eHeight);
+    put(16, eWidth);
+    put(28, eMips);
+    put(76, 32); // pixel format size
+    put(80, 0x4); // FourCC
+    memcpy(&ret[84], "DX10", 4);
+    put(108, 0x401008); // complex, mipmap, texture
+    put(128, DXGI_FORMAT_R8G8B8A8_UNORM);
+    put(132, 3); // 2D resource dimension
+    put(140, 1); // array size
+    for (uint32_t level = 0; level < eMips; ++level) {
+        size_t texels = (size_t)(std::max)(eWidth >> level, 1u) * (std::max)(eHeight >> level, 1u);
+        ret.insert(ret.end(), 4 * texels, (uint8_t)level);
+    }
+    return ret;
+}
+
+uint32_t ReadU32(std::vector<uint8_t> const &data, size_t offset) {
+    uint32_t ret;
+    memcpy(&ret, &data[offset], sizeof(ret));
+    return ret;
+}
+
+void TestReadDdsFile() {
+    auto dir = TestDirectory("dds");
+    auto dds = TestDds();
+    auto path = dir / "tex.dds";
+    CHECK(WriteBinaryFile(path, dds));
+
+    uint64_t seenWidth{}, seenHeight{};
+    uint32_t seenMips{};
+    auto trimmed = ReadDdsFile(path, [&](uint64_t width, uint64_t height, uint32_t mips) {
+        seenWidth = width, seenHeight = height, seenMips = mips;
+        return 2u;
+    });
+    CHECK(seenWidth == 16 && seenHeight == 8 && seenMips == 5);
+    CHECK(trimmed && trimmed->skippedMips == 2 && trimmed->data.size() == 148 + (8 + 2 + 1) * 4);
+    if (trimmed && trimmed->data.size() == 148 + (8 + 2 + 1) * 4) {
+        CHECK(ReadU32(trimmed->data, 12) == 2 && ReadU32(trimmed->data, 16) == 4 && ReadU32(trimmed->data, 28) == 3);
+        CHECK(trimmed->data[148] == 2 && trimmed->data.back() == 4);
+        CHECK(memcmp(trimmed->data.data() + 128, dds.data() + 128, 20) == 0);
+        // The rewritten header describes the remaining chain to DirectXTex.
+        DirectX::TexMetadata meta{};
+        CHECK(SUCCEEDED(DirectX::GetMetadataFromDDSMemory(trimmed->data.data(), trimmed->data.size(),
+                                                         DirectX::DDS_FLAGS_NONE, meta)));
+        CHECK(meta.width == 4 && meta.height == 2 && meta.mipLevels == 3);
+    }
+
+    // The last mip is always kept.
+    auto coarsest = ReadDdsFile(path, [](uint64_t, uint64_t, uint32_t) { return 10u; });
+    CHECK(coarsest && coarsest->skippedMips == 4 && coarsest->data.size() == 148 + 4);
+
+    auto whole = ReadDdsFile(path, [](uint64_t, uint64_t, uint32_t) { return 0u; });
+    CHECK(whole && whole->skippedMips == 0 && whole->data == dds);
+
+    // A file whose size does not match its header is read whole.
+    auto padded = dds;
+    padded.push_back(0);
+    CHECK(WriteBinaryFile(path, padded));
+    whole = ReadDdsFile(path, [](uint64_t, uint64_t, uint32_t) { return 2u; });
+    CHECK(whole && whole->skippedMips == 0 && whole->data == padded);
+
+    CHECK(!ReadDdsFile(dir / "missing.dds", [](uint64_t, uint64_t, uint32_t) { return 0u; }));
+}
+
+void TestTextureFootprint() {
+    TextureFootprint footprint{.width = 256, .height = 256};
+    // 8 texels per pixel is level 3, less the sampler bias and the margin level.
+    CHECK(footprint.FinestMip(2048, 2048, 12) == 1);
+    CHECK(footprint.FinestMip(2048, 2048, 1) == 0);
+    CHECK(footprint.FinestMip(256, 256, 9) == 0);
+    TextureFootprint halfScale{.width = 256, .height = 256, .minUvScale = 0.5f};
+    CHECK(halfScale.FinestMip(2048, 2048, 12) == 0);
+    CHECK(TextureFootprint{}.FinestMip(2048, 2048, 12) == 0);
+
+    TextureFootprint larger{.width = 512, .height = 256};
+    CHECK(larger.Covers(footprint) && !footprint.Covers(larger));
+    CHECK(TextureFootprint{}.Covers(larger) && !larger.Covers(TextureFootprint{}));
+
+    TextureFootprint magnified{.width = 128, .height = 512, .minUvScale = 0.5f};
+    auto both = footprint.Union(magnified);
+    CHECK(both.width == 256 && both.height == 512 && both.minUvScale == 0.5f);
+    CHECK(both.Covers(footprint) && both.Covers(magnified));
+    CHECK(footprint.Union(TextureFootprint{}).width == 0);
+}
+} // namespace
+
+int main() {
+    TestReadDdsFile();
+    TestTextureFootprint();
+    return CheckResult();
+}
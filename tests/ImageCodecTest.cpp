@@ -0,0 +1,218 @@
+#include "Check.hpp"
+
+#include "ImageCodec.hpp"
+
+#include <zlib.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <random>
+#include <string>
+#include <utility>
+
+namespace {
+uint32_t ReadU32(uint8_t const *p) { return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | p[3]; }
+
+struct Image {
+    int width{}, height{};
+    std::vector<uint8_t> pixels; // tightly packed RGBA8
+};
+
+// Decodes the 8-bit RGBA PNGs PngEncoder writes, checking every chunk's CRC.
+std::optional<Image> DecodePng(std::vector<uint8_t> const &png) {
+    uint8_t const signature[]{0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    if (png.size() < 8 || memcmp(png.data(), signature, 8) != 0) {
+        return std::nullopt;
+    }
+    Image ret;
+    std::vector<uint8_t> zlibStream;
+    bool ended = false;
+    for (size_t offset = 8; offset + 12 <= png.size() && !ended;) {
+        uint32_t size = ReadU32(&png[offset]);
+        if (offset + 12 + size > png.size() ||
+            crc32(0, &png[offset + 4], size + 4) != ReadU32(&png[offset + 8 + size])) {
+            return std::nullopt;
+        }
+        std::string type((char const *)&png[offset + 4], 4);
+        uint8_t const *data = &png[offset + 8];
+        if (type == "IHDR") {
+            ret.width = (int)ReadU32(data);
+            ret.height = (int)ReadU32(data + 4);
+            if (data[8] != 8 || data[9] != 6 || data[12] != 0) {
+                return std::nullopt;
+            }
+        } else if (type == "IDAT") {
+            zlibStream.insert(zlibStream.end(), data, data + size);
+        }
+        ended = type == "IEND";
+        offset += 12 + size;
+    }
+    size_t rowBytes = 4 * (size_t)ret.width;
+    std::vector<uint8_t> filtered((rowBytes + 1) * ret.height);
+    uLongf filteredSize = (uLongf)filtered.size();
+    if (!ended || uncompress(filtered.data(), &filteredSize, zlibStream.data(), (uLong)zlibStream.size()) != Z_OK ||
+        filteredSize != filtered.size()) {
+        return std::nullopt;
+    }
+
+    ret.pixels.resize(rowBytes * ret.height);
+    for (int y = 0; y < ret.height; ++y) {
+        uint8_t const *in = &filtered[y * (rowBytes + 1)];
+        uint8_t *cur = &ret.pixels[y * rowBytes];
+        uint8_t const *prev = y ? cur - rowBytes : nullptr;
+        for (size_t i = 0; i < rowBytes; ++i) {
+            int a = i >= 4 ? cur[i - 4] : 0, b = prev ? prev[i] : 0, c = prev && i >= 4 ? prev[i - 4] : 0;
+            int pred = 0;
+            switch (in[0]) {
+            case 0:
+                break;
+            case 1:
+                pred = a;
+                break;
+            case 2:
+                pred = b;
+                break;
+            case 3:
+                pred = (a + b) >> 1;
+                break;
+            case 4: {
+                int pa = std::abs(b - c), pb = std::abs(a - c), pc = std::abs(a + b - 2 * c);
+                pred = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+                break;
+            }
+            default:
+                return std::nullopt;
+            }
+            cur[i] = uint8_t(in[1 + i] + pred);
+        }
+    }
+    return ret;
+}
+
+// Decodes QOI as described in https://qoiformat.org/qoi-specification.pdf.
+std::optional<Image> DecodeQoi(std::vector<uint8_t> const &qoi) {
+    if (qoi.size() < 22 || memcmp(qoi.data(), "qoif", 4) != 0) {
+        return std::nullopt;
+    }
+    Image ret{.width = (int)ReadU32(&qoi[4]), .height = (int)ReadU32(&qoi[8])};
+    ret.pixels.resize(4 * (size_t)ret.width * ret.height);
+    uint8_t seen[64][4]{};
+    uint8_t px[4]{0, 0, 0, 255};
+    size_t offset = 14, end = qoi.size() - 8;
+    int run = 0;
+    for (size_t out = 0; out < ret.pixels.size(); out += 4) {
+        if (run > 0) {
+            --run;
+        } else if (offset < end) {
+            uint8_t op = qoi[offset++];
+            if (op == 0xFE) {
+                memcpy(px, &qoi[offset], 3);
+                offset += 3;
+            } else if (op == 0xFF) {
+                memcpy(px, &qoi[offset], 4);
+                offset += 4;
+            } else if ((op & 0xC0) == 0x00) {
+                memcpy(px, seen[op], 4);
+            } else if ((op & 0xC0) == 0x40) {
+                px[0] += ((op >> 4) & 3) - 2;
+                px[1] += ((op >> 2) & 3) - 2;
+                px[2] += (op & 3) - 2;
+            } else if ((op & 0xC0) == 0x80) {
+                int dg = (op & 0x3F) - 32;
+                uint8_t next = qoi[offset++];
+                px[0] += dg + ((next >> 4) & 0xF) - 8;
+                px[1] += dg;
+                px[2] += dg + (next & 0xF) - 8;
+            } else {
+                run = op & 0x3F;
+            }
+            memcpy(seen[(px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64], px, 4);
+        }
+        memcpy(&ret.pixels[out], px, 4);
+    }
+    uint8_t const padding[]{0, 0, 0, 0, 0, 0, 0, 1};
+    if (memcmp(&qoi[end], padding, 8) != 0) {
+        return std::nullopt;
+    }
+    return ret;
+}
+
+// A frame mixing noise, flat runs and gradients, so every PNG filter and QOI op gets used.
+struct TestFrame {
+    TestFrame(int width, int height, uint32_t seed) {
+        // Rows are padded so the encoders have to honour the row pitch.
+        frame = {.width = (uint32_t)width, .height = (uint32_t)height, .rowPitch = 4 * (size_t)width + 16};
+        storage.resize(frame.rowPitch * height);
+        frame.pixels = storage.data();
+        std::mt19937 rng(seed);
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                uint8_t *px = frame.Pixel(x, y);
+                int band = (x / 7 + y / 5) % 3;
+                for (int c = 0; c < 4; ++c) {
+                    px[c] = band == 0 ? uint8_t(rng()) : band == 1 ? uint8_t(x * 3 + y + c) : uint8_t(40 * c);
+                }
+            }
+        }
+    }
+
+    bool Matches(Image const &image, PixelRect rect) const {
+        if (image.width != rect.width || image.height != rect.height) {
+            return false;
+        }
+        for (int y = 0; y < rect.height; ++y) {
+            if (memcmp(&image.pixels[4 * (size_t)y * rect.width], frame.Pixel(rect.x, rect.y + y),
+                       4 * (size_t)rect.width) != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::vector<uint8_t> storage;
+    FrameBuffer frame;
+};
+
+void TestPngRoundTrip() {
+    for (int level : {0, 1, 6, 9}) {
+        for (unsigned threads : {1u, 3u, 8u}) {
+            // One encoder per setting across every size, so its buffers are reused after growing and shrinking.
+            PngEncoder encoder({.level = level, .threads = threads});
+            std::vector<uint8_t> png;
+            for (auto [width, height] : {std::pair{1, 1}, {7, 3}, {64, 100}, {390, 257}, {33, 40}}) {
+                TestFrame frame(width, height, width * 31 + height);
+                for (PixelRect rect : {PixelRect{0, 0, width, height},
+                                       PixelRect{width / 3, height / 4, width - width / 3, height / 2 + 1}}) {
+                    CHECK(encoder.Encode(frame.frame, rect, png));
+                    auto image = DecodePng(png);
+                    CHECK(image && frame.Matches(*image, rect));
+                }
+            }
+        }
+    }
+}
+
+void TestQoiRoundTrip() {
+    for (auto [width, height] : {std::pair{1, 1}, {70, 3}, {128, 96}}) {
+        TestFrame frame(width, height, width + height);
+        PixelRect rect{0, 0, width, height};
+        auto image = DecodeQoi(EncodeQoi(frame.frame, rect));
+        CHECK(image && frame.Matches(*image, rect));
+    }
+
+    // Runs longer than one op holds and a single repeated color.
+    std::vector<uint8_t> flat(4 * 200 * 2, 0x80);
+    FrameBuffer frame{.width = 200, .height = 2, .rowPitch = 800, .pixels = flat.data()};
+    auto qoi = EncodeQoi(frame, {0, 0, 200, 2});
+    auto image = DecodeQoi(qoi);
+    CHECK(image && image->pixels == flat);
+    CHECK(qoi.size() < 40);
+}
+} // namespace
+
+int main() {
+    TestPngRoundTrip();
+    TestQoiRoundTrip();
+    return CheckResult();
+}
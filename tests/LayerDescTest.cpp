@@ -0,0 +1,122 @@
+#include "Check.hpp"
+
+#include "D3D.hpp"
+#include "LayerDesc.hpp"
+
+#include <fstream>
+
+namespace {
+std::vector<std::string> Split(std::string const &text) {
+    std::vector<std::string> ret;
+    for (size_t begin = 0, end; begin < text.size(); begin = end + 1) {
+        end = text.find(' ', begin);
+        end = end == std::string::npos ? text.size() : end;
+        ret.push_back(text.substr(begin, end - begin));
+    }
+    return ret;
+}
+
+std::optional<LayerCatalog> LoadText(std::string const &name, std::string const &text) {
+    auto path = TestDirectory("layer-desc-" + name) / "layers.txt";
+    std::ofstream(path) << text;
+    return LoadLayerCatalog(path);
+}
+
+void TestParseLayerParam() {
+    auto uintParam = ParseLayerParam(Split("param uint octaves 5"));
+    CHECK(uintParam && uintParam->field == "octaves" && uintParam->isUint && uintParam->components == 1);
+    CHECK(uintParam && uintParam->bits[0] == 5 && !uintParam->specialize);
+
+    auto floatParam = ParseLayerParam(Split("const float strength -0.25"));
+    CHECK(floatParam && !floatParam->isUint && floatParam->Float() == -0.25f && floatParam->specialize);
+
+    auto float3 = ParseLayerParam(Split("param float3 tint 1 0.5 2"));
+    CHECK(float3 && float3->components == 3);
+    CHECK(float3 && float3->Float(0) == 1.0f && float3->Float(1) == 0.5f && float3->Float(2) == 2.0f);
+
+    CHECK(!ParseLayerParam(Split("param float")));
+    CHECK(!ParseLayerParam(Split("param double x 1")));
+    CHECK(!ParseLayerParam(Split("param float5 x 1 2 3 4 5")));
+    CHECK(!ParseLayerParam(Split("param float2 x 1")));
+    CHECK(!ParseLayerParam(Split("param float2 x 1 2 3")));
+    CHECK(!ParseLayerParam(Split("param uint x -1")));
+    CHECK(!ParseLayerParam(Split("param float x 1.5abc")));
+}
+
+void TestLoadLayerCatalog() {
+    auto catalog = LoadText("valid", R"(# comment
+[layer bg]
+kind draw2d
+shader bg.hlsl main_ps   # trailing comment
+texture tex0 art/bg.dds srgb
+texture tex1 -
+solid tex2 4 4 ff804020
+param float2 tex_scale 0.5 2
+
+[layer shaper]
+kind atlas
+shader shaper.hlsl shaper_ps
+const uint octaves 3
+
+[combos]
+combo 0
+combo 0 1
+)");
+    CHECK(catalog.has_value());
+    if (!catalog) {
+        return;
+    }
+    CHECK(catalog->layers.size() == 2 && catalog->combos.size() == 2);
+    CHECK(catalog->combos.size() == 2 && catalog->combos[1] == std::vector<int>({0, 1}));
+    if (catalog->layers.size() != 2) {
+        return;
+    }
+
+    auto &bg = catalog->layers[0];
+    CHECK(bg.name == "bg" && bg.kind == LayerKind::Draw2D && bg.fragment == "bg.hlsl" && bg.entrypoint == "main_ps");
+    CHECK(bg.textures.size() == 3);
+    if (bg.textures.size() == 3) {
+        CHECK(bg.textures[0].name == "tex0" && bg.textures[0].path == "art/bg.dds" && bg.textures[0].srgb);
+        CHECK(bg.textures[1].path.empty() && !bg.textures[1].solid);
+        CHECK(bg.textures[2].solid && bg.textures[2].width == 4 && bg.textures[2].color == 0xFF804020);
+    }
+    auto *texScale = bg.FindParam("tex_scale");
+    CHECK(texScale && !texScale->isUint && texScale->components == 2 && !texScale->specialize);
+    CHECK(texScale && texScale->Float(0) == 0.5f && texScale->Float(1) == 2.0f && !bg.FindParam("octaves"));
+    CHECK(bg.MinUvScale() == 0.5f);
+
+    auto &shaper = catalog->layers[1];
+    CHECK(shaper.kind == LayerKind::AtlasEffects && shaper.params.size() == 1);
+    CHECK(shaper.params.size() == 1 && shaper.params[0].isUint && shaper.params[0].bits[0] == 3);
+    CHECK(shaper.params.size() == 1 && shaper.params[0].specialize);
+    CHECK(shaper.MinUvScale() == 1.0f);
+
+    // Only const lines, solid textures and unbound textures are compiled into the shader.
+    auto bgSpecialization = bg.Specialization();
+    CHECK(bgSpecialization.constants.empty() && bgSpecialization.textures.size() == 2);
+    if (bgSpecialization.textures.size() == 2) {
+        CHECK(bgSpecialization.textures[0].name == "tex1" && bgSpecialization.textures[0].value[3] == 0.0f);
+        CHECK(bgSpecialization.textures[1].name == "tex2" && bgSpecialization.textures[1].value[3] == 1.0f);
+    }
+    auto shaperSpecialization = shaper.Specialization();
+    CHECK(shaperSpecialization.constants.size() == 1 && shaperSpecialization.constants[0].field == "octaves");
+}
+
+void TestLoadLayerCatalogErrors() {
+    CHECK(!LoadLayerCatalog(TestDirectory("layer-desc-missing") / "layers.txt"));
+    CHECK(!LoadText("no-layer", "kind draw2d\n"));
+    CHECK(!LoadText("kind", "[layer a]\nkind sprite\nshader a.hlsl ps\n"));
+    CHECK(!LoadText("no-shader", "[layer a]\nkind draw2d\n"));
+    CHECK(!LoadText("param", "[layer a]\nshader a.hlsl ps\nparam float x\n"));
+    CHECK(!LoadText("texture", "[layer a]\nshader a.hlsl ps\nsolid t 0 4 ffffffff\n"));
+    CHECK(!LoadText("combo", "[layer a]\nshader a.hlsl ps\n[combos]\ncombo 0 1\n"));
+    CHECK(!LoadText("after-combos", "[layer a]\nshader a.hlsl ps\n[combos]\nkind draw2d\n"));
+}
+} // namespace
+
+int main() {
+    TestParseLayerParam();
+    TestLoadLayerCatalog();
+    TestLoadLayerCatalogErrors();
+    return CheckResult();
+}
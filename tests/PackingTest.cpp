@@ -0,0 +1,55 @@
+#include "Check.hpp"
+
+#include "Packing.hpp"
+#include "Util.hpp"
+
+namespace {
+bool Overlap(PixelRect const &l, PixelRect const &r) {
+    return l.x < r.x + r.width && r.x < l.x + l.width && l.y < r.y + r.height && r.y < l.y + l.height;
+}
+
+void TestPackTiles() {
+    for (int count : {1, 2, 3, 4, 5, 10, 17}) {
+        std::vector<std::string> names;
+        std::vector<std::vector<int>> layers;
+        for (int i = 0; i < count; ++i) {
+            names.push_back("div_bg_" + std::to_string(i));
+            layers.push_back({i, i + 1});
+        }
+        auto layout = PackTiles(names, layers, 390, 585);
+        CHECK((int)layout.tiles.size() == count);
+        CHECK(layout.columns * layout.rows >= count);
+        CHECK((layout.columns - 1) * layout.rows < count); // no empty column
+        CHECK(layout.columns >= layout.rows);
+        CHECK(layout.width == layout.columns * 390 && layout.height == layout.rows * 585);
+        for (int i = 0; i < count; ++i) {
+            auto &tile = layout.tiles[i];
+            CHECK(tile.name == names[i] && tile.layers == layers[i]);
+            CHECK(tile.rect.width == 390 && tile.rect.height == 585);
+            CHECK(tile.rect.x >= 0 && tile.rect.x + tile.rect.width <= layout.width);
+            CHECK(tile.rect.y >= 0 && tile.rect.y + tile.rect.height <= layout.height);
+            for (int j = 0; j < i; ++j) {
+                CHECK(!Overlap(tile.rect, layout.tiles[j].rect));
+            }
+        }
+    }
+}
+
+void TestManifest() {
+    auto dir = TestDirectory("packing");
+    auto layout = PackTiles({"div_bg_0", "quote\"back\\slash"}, {{0}, {1, 2}}, 4, 2);
+    auto path = dir / "packed.json";
+    CHECK(WritePackedManifest(path, layout, "div_bg_packed-%04d.png", 300, 60.0f));
+    auto json = SlurpTextFile(path);
+    CHECK(json.find("\"framePattern\": \"div_bg_packed-%04d.png\"") != std::string::npos);
+    CHECK(json.find("\"name\": \"quote\\\"back\\\\slash\", \"layers\": [1, 2], \"x\": 4, \"y\": 0") !=
+          std::string::npos);
+    CHECK(json.find("\"width\": 8") != std::string::npos && json.find("\"frames\": 300") != std::string::npos);
+}
+} // namespace
+
+int main() {
+    TestPackTiles();
+    TestManifest();
+    return CheckResult();
+}
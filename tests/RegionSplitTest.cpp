@@ -0,0 +1,121 @@
+#include "Check.hpp"
+
+#include "RegionSplit.hpp"
+#include "Util.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+bool Contains(PixelRect const &outer, PixelRect const &inner) {
+    return inner.x >= outer.x && inner.y >= outer.y && inner.x + inner.width <= outer.x + outer.width &&
+           inner.y + inner.height <= outer.y + outer.height;
+}
+
+bool Overlap(PixelRect const &l, PixelRect const &r) {
+    return l.x < r.x + r.width && r.x < l.x + l.width && l.y < r.y + r.height && r.y < l.y + l.height;
+}
+
+// A gray loop in which the given rectangles flicker between black and white.
+TemporalStats FlickerLoop(int width, int height, std::vector<PixelRect> const &animated, int frames = 8) {
+    std::vector<uint8_t> pixels(4 * (size_t)width * height);
+    FrameBuffer frame{.width = (uint32_t)width, .height = (uint32_t)height, .rowPitch = 4 * (size_t)width};
+    frame.pixels = pixels.data();
+    TemporalStats stats;
+    stats.Reset(width, height);
+    for (int i = 0; i < frames; ++i) {
+        memset(pixels.data(), 0x80, pixels.size());
+        for (auto &rect : animated) {
+            for (int y = rect.y; y < rect.y + rect.height; ++y) {
+                memset(frame.Pixel(rect.x, y), i % 2 ? 0xFF : 0x00, 4 * (size_t)rect.width);
+            }
+        }
+        stats.Accumulate(frame);
+    }
+    return stats;
+}
+
+void TestStaticLoop() {
+    auto stats = FlickerLoop(32, 16, {});
+    CHECK(FindAnimatedRegions(stats, {}).empty());
+
+    std::vector<uint8_t> mean(4 * 32 * 16);
+    FrameBuffer out{.width = 32, .height = 16, .rowPitch = 4 * 32, .pixels = mean.data()};
+    stats.MeanInto(out);
+    CHECK(std::all_of(mean.begin(), mean.end(), [](uint8_t v) { return v == 0x80; }));
+    CHECK(!stats.IsAnimated(5, 5, 1.0f, 8));
+}
+
+void TestSeparateRegions() {
+    PixelRect top{5, 4, 7, 9}, bottom{40, 44, 12, 11};
+    auto stats = FlickerLoop(64, 64, {top, bottom});
+    CHECK(stats.IsAnimated(top.x, top.y, 1.0f, 8) && !stats.IsAnimated(30, 30, 1.0f, 8));
+
+    auto regions = FindAnimatedRegions(stats, {.maxRegions = 4, .alignment = 2});
+    CHECK(regions.size() == 2);
+    if (regions.size() == 2) {
+        // Sorted top to bottom, each covering one flickering rectangle snapped outwards to even edges.
+        CHECK(Contains(regions[0], top) && Contains(regions[1], bottom));
+        CHECK(!Overlap(regions[0], bottom) && !Overlap(regions[1], top));
+        for (auto &region : regions) {
+            CHECK(region.x % 2 == 0 && region.y % 2 == 0 && region.width % 2 == 0 && region.height % 2 == 0);
+            CHECK(Contains({0, 0, 64, 64}, region));
+        }
+        CHECK(regions[0].Area() <= (top.width + 2) * (top.height + 2));
+    }
+
+    // With room for one region it is the bounding box of both.
+    regions = FindAnimatedRegions(stats, {.maxRegions = 1, .alignment = 1});
+    CHECK(regions.size() == 1);
+    if (regions.size() == 1) {
+        CHECK(regions[0].x == 5 && regions[0].y == 4);
+        CHECK(regions[0].x + regions[0].width == 52 && regions[0].y + regions[0].height == 55);
+    }
+}
+
+void TestThresholds() {
+    // A change of 4 levels stays below the default range and deviation limits; a stricter range catches it.
+    std::vector<uint8_t> pixels(4 * 8 * 8, 0x80);
+    FrameBuffer frame{.width = 8, .height = 8, .rowPitch = 32, .pixels = pixels.data()};
+    TemporalStats stats;
+    stats.Reset(8, 8);
+    for (int i = 0; i < 4; ++i) {
+        frame.Pixel(3, 3)[0] = uint8_t(0x80 + (i % 2) * 4);
+        stats.Accumulate(frame);
+    }
+    CHECK(!stats.IsAnimated(3, 3, 3.0f, 8));
+    CHECK(stats.IsAnimated(3, 3, 3.0f, 2));
+    CHECK(stats.IsAnimated(3, 3, 1.0f, 8));
+}
+
+void TestManifest() {
+    auto dir = TestDirectory("region-split");
+    RegionManifest manifest{
+        .name = "div_bg_0_1",
+        .width = 390,
+        .height = 585,
+        .base = "div_bg_0_1-base.png",
+        .regions = {{{0, 10, 100, 50}, "div_bg_0_1-r0-%04d.png"}},
+        .numFrames = 300,
+        .fps = 60.0f,
+    };
+    auto path = dir / "manifest.json";
+    CHECK(WriteRegionManifest(path, manifest));
+    auto json = SlurpTextFile(path);
+    CHECK(json.find("\"base\": \"div_bg_0_1-base.png\"") != std::string::npos);
+    CHECK(json.find("{\"x\": 0, \"y\": 10, \"width\": 100, \"height\": 50, \"frames\": \"div_bg_0_1-r0-%04d.png\"}") !=
+          std::string::npos);
+
+    manifest.name = "tab\there";
+    CHECK(WriteRegionManifest(path, manifest));
+    CHECK(SlurpTextFile(path).find("\"name\": \"tab\\there\"") != std::string::npos);
+}
+} // namespace
+
+int main() {
+    TestStaticLoop();
+    TestSeparateRegions();
+    TestThresholds();
+    TestManifest();
+    return CheckResult();
+}
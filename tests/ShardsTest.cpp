@@ -0,0 +1,73 @@
+#include "Check.hpp"
+
+#include "Shards.hpp"
+
+namespace {
+bool Equal(std::optional<IndexRange> range, int begin, int end) {
+    return range && range->begin == begin && range->end == end;
+}
+
+void TestParseIndexRange() {
+    CHECK(Equal(ParseIndexRange("0-9"), 0, 10));
+    CHECK(Equal(ParseIndexRange("7"), 7, 8));
+    CHECK(Equal(ParseIndexRange("5-5"), 5, 6));
+    CHECK(Equal(ParseIndexRange("120-299"), 120, 300));
+    CHECK(!ParseIndexRange(""));
+    CHECK(!ParseIndexRange("-"));
+    CHECK(!ParseIndexRange("9-3"));
+    CHECK(!ParseIndexRange("-4"));
+    CHECK(!ParseIndexRange("3-"));
+    CHECK(!ParseIndexRange("1-2-3"));
+    CHECK(!ParseIndexRange("a-b"));
+    CHECK(!ParseIndexRange("4 "));
+}
+
+// Every frame of every combo lands in exactly one shard, in order.
+void TestPlanShards() {
+    auto shards = PlanShards(3, 300, 50);
+    CHECK(shards.size() == 18);
+    int expected = 0;
+    for (auto &shard : shards) {
+        CHECK(shard.combos.Size() == 1 && !shard.packed);
+        CHECK(shard.combos.begin * 300 + shard.frames.begin == expected);
+        CHECK(shard.frames.Size() == 50 && shard.ExpectedFrames() == 50);
+        expected += shard.frames.Size();
+    }
+    CHECK(expected == 900);
+
+    // A remainder becomes a short last shard per combo.
+    shards = PlanShards(2, 120, 50);
+    CHECK(shards.size() == 6);
+    CHECK(shards[2].frames.begin == 100 && shards[2].frames.end == 120);
+    CHECK(shards[3].combos.begin == 1 && shards[3].frames.begin == 0);
+
+    // Packed shards split the frames of the shared sequence and cover every combo.
+    shards = PlanShards(5, 120, 50, true);
+    CHECK(shards.size() == 3);
+    for (auto &shard : shards) {
+        CHECK(shard.packed && shard.combos.begin == 0 && shard.combos.end == 5);
+        CHECK(shard.ExpectedFrames() == shard.frames.Size());
+    }
+    CHECK(shards.back().frames.begin == 100 && shards.back().frames.end == 120);
+
+    CHECK(PlanShards(0, 300, 50).empty());
+    CHECK(PlanShards(1, 10, 0).size() == 10); // at least one frame per shard
+}
+
+void TestShardNames() {
+    ShardSpec shard{.combos = {2, 3}, .frames = {50, 100}};
+    CHECK(shard.Name() == "c2-2_f50-99");
+    CHECK(shard.CommandLineArgs() == "--combos 2-2 --frames 50-99");
+    shard.packed = true;
+    CHECK(shard.CommandLineArgs() == "--combos 2-2 --frames 50-99 --packed");
+    // The worker parses the same ranges back.
+    CHECK(Equal(ParseIndexRange("50-99"), shard.frames.begin, shard.frames.end));
+}
+} // namespace
+
+int main() {
+    TestParseIndexRange();
+    TestPlanShards();
+    TestShardNames();
+    return CheckResult();
+}
@@ -0,0 +1,89 @@
+#include "Check.hpp"
+
+#include "Sweep.hpp"
+
+#include <bit>
+#include <fstream>
+
+namespace {
+std::optional<SweepSpec> LoadText(std::string const &name, std::string const &text) {
+    auto path = TestDirectory("sweep-" + name) / "sweep.txt";
+    std::ofstream(path) << text;
+    return LoadSweepSpec(path);
+}
+
+void TestLoadSweepSpec() {
+    auto spec = LoadText("valid", R"(# comment
+combo 1
+columns 3
+vary shaper float muddle_frequency 5 10 20
+vary shaper float2 offset 0,1 2.5,-1   # trailing comment
+vary bg uint octaves 2 4
+)");
+    CHECK(spec.has_value());
+    if (!spec) {
+        return;
+    }
+    CHECK(spec->combo == 1 && spec->columns == 3 && spec->axes.size() == 3 && spec->VariantCount() == 12);
+    if (spec->axes.size() == 3) {
+        CHECK(spec->axes[0].layer == "shaper" && spec->axes[0].values.size() == 3);
+        CHECK(spec->axes[0].values[2].field == "muddle_frequency" && spec->axes[0].values[2].Float() == 20.0f);
+        auto &offset = spec->axes[1].values[1];
+        CHECK(offset.components == 2 && offset.Float(0) == 2.5f && offset.Float(1) == -1.0f);
+        CHECK(spec->axes[2].layer == "bg" && spec->axes[2].values[1].isUint && spec->axes[2].values[1].bits[0] == 4);
+    }
+
+    CHECK(!LoadSweepSpec(TestDirectory("sweep-missing") / "sweep.txt"));
+    CHECK(!LoadText("nothing", "combo 1\n"));
+    CHECK(!LoadText("combo", "combo -1\nvary a float x 1\n"));
+    CHECK(!LoadText("columns", "columns many\nvary a float x 1\n"));
+    CHECK(!LoadText("components", "vary a float2 x 1,2 3\n"));
+    CHECK(!LoadText("no-values", "vary a float x\n"));
+    CHECK(!LoadText("unknown", "vary a float x 1\nrows 2\n"));
+}
+
+void TestExpandSweep() {
+    LayerCatalog catalog{
+        .layers = {{.name = "bg", .params = {{.field = "octaves", .isUint = true, .bits = {1}, .specialize = true}}},
+                   {.name = "shaper", .params = {{.field = "speed", .bits = {0x3F800000}, .specialize = true}}}},
+        .combos = {{0}, {0, 1}},
+    };
+    SweepSpec spec{.combo = 1};
+    auto value = [](std::string field, float x, bool isUint = false) {
+        LayerParamDesc ret{.field = field, .isUint = isUint};
+        ret.bits[0] = isUint ? (uint32_t)x : std::bit_cast<uint32_t>(x);
+        return ret;
+    };
+    spec.axes.push_back({.layer = "bg", .values = {value("octaves", 2, true), value("octaves", 3, true)}});
+    spec.axes.push_back({.layer = "shaper", .values = {value("speed", 0.5f), value("speed", 2), value("speed", 4)}});
+
+    auto variants = ExpandSweep(spec, catalog);
+    CHECK(variants && variants->layers.size() == 6 && variants->labels.size() == 6);
+    if (!variants || variants->layers.size() != 6) {
+        return;
+    }
+    // The first axis varies slowest.
+    CHECK(variants->labels[0] == "bg.octaves=2 shaper.speed=0.5");
+    CHECK(variants->labels[1] == "bg.octaves=2 shaper.speed=2");
+    CHECK(variants->labels[5] == "bg.octaves=3 shaper.speed=4");
+    auto &last = variants->layers[5];
+    CHECK(last.size() == 2 && last[0].name == "bg" && last[1].name == "shaper");
+    if (last.size() == 2) {
+        auto *octaves = last[0].FindParam("octaves");
+        auto *speed = last[1].FindParam("speed");
+        CHECK(octaves && octaves->bits[0] == 3 && !octaves->specialize && last[0].params.size() == 1);
+        CHECK(speed && speed->Float() == 4.0f && !speed->specialize);
+    }
+
+    spec.combo = 2;
+    CHECK(!ExpandSweep(spec, catalog));
+    spec.combo = 0; // shaper is not part of combo 0
+    CHECK(!ExpandSweep(spec, catalog));
+}
+} // namespace
+
+int main() {
+    TestLoadSweepSpec();
+    TestExpandSweep();
+    return CheckResult();
+}